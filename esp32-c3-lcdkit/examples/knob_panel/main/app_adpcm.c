@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "app_adpcm.h"
+
+static const int16_t adpcm_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t adpcm_index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static inline int16_t adpcm_decode_nibble(uint8_t code, int32_t *predictor, int32_t *index)
+{
+    int32_t step = adpcm_step_table[*index];
+    int32_t diff = step >> 3;
+
+    if (code & 4) {
+        diff += step;
+    }
+    if (code & 2) {
+        diff += step >> 1;
+    }
+    if (code & 1) {
+        diff += step >> 2;
+    }
+
+    int32_t p = *predictor + ((code & 8) ? -diff : diff);
+    *predictor = (p > INT16_MAX) ? INT16_MAX : (p < INT16_MIN) ? INT16_MIN : p;
+
+    int32_t i = *index + adpcm_index_table[code & 7];
+    *index = (i < 0) ? 0 : (i > 88) ? 88 : i;
+    return *predictor;
+}
+
+size_t adpcm_decode_block(const uint8_t *block, size_t len, int16_t *pcm)
+{
+    if ((len < ADPCM_BLOCK_HEADER) || (len > ADPCM_BLOCK_SIZE) || (block[2] > 88)) {
+        return 0;
+    }
+
+    int32_t predictor = (int16_t)(block[0] | (block[1] << 8));
+    int32_t index = block[2];
+    size_t n = 0;
+
+    pcm[n++] = predictor;
+    for (size_t i = ADPCM_BLOCK_HEADER; i < len; i++) {
+        pcm[n++] = adpcm_decode_nibble(block[i] & 0x0F, &predictor, &index);
+        pcm[n++] = adpcm_decode_nibble(block[i] >> 4, &predictor, &index);
+    }
+    if ((block[3] & ADPCM_BLOCK_PADDED) && (n > 1)) {
+        n--;
+    }
+    return n;
+}
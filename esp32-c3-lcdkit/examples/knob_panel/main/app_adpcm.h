@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Mono IMA-ADPCM blocks as written by tools/pack_prompts.py, keep both in sync */
+#define ADPCM_BLOCK_SIZE        256
+#define ADPCM_BLOCK_HEADER      4
+#define ADPCM_BLOCK_SAMPLES     (1 + 2 * (ADPCM_BLOCK_SIZE - ADPCM_BLOCK_HEADER))
+
+/* Block flag: the high nibble of the last byte is padding, the block holds an even number of samples */
+#define ADPCM_BLOCK_PADDED      0x01
+
+/**
+ * @brief Decode one block: int16 first sample, uint8 step index, uint8 flags, then 4 bit codes, low nibble first
+ *
+ * @param block Block data
+ * @param len Block length, only the last block of a prompt may be shorter than ADPCM_BLOCK_SIZE,
+ *            down to the header alone for a single sample
+ * @param pcm Output, room for ADPCM_BLOCK_SAMPLES
+ *
+ * @return Number of samples decoded, 0 if the block is malformed
+ */
+size_t adpcm_decode_block(const uint8_t *block, size_t len, int16_t *pcm);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,8 +5,11 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include "freertos/task.h"
 #include "esp_task_wdt.h"
@@ -14,92 +17,261 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_timer.h"
-#include "esp_spiffs.h"
-#include "esp_vfs.h"
 
+#include "app_adpcm.h"
 #include "app_audio.h"
+#include "app_audio_mixer.h"
+#include "app_event_ring.h"
+#include "app_prompt_archive.h"
+#include "app_prompt_cache.h"
+#include "app_prompt_queue.h"
 #include "audio_player.h"
 #include "bsp/esp-bsp.h"
+#if AUDIO_DECODE_BENCH
+#include "esp_heap_caps.h"
+#include "mp3dec.h"
+#endif
 
 static const char *TAG = "app_audio";
 
 static esp_codec_dev_handle_t play_dev_handle;
 
+/* Configuration the codec is open with, reopened only when it changes or after the idle window */
+static SemaphoreHandle_t codec_mutex;
+static esp_codec_dev_sample_info_t codec_fs;
+static bool codec_is_open;
+static esp_timer_handle_t codec_idle_timer;
+
+/* Source of the prompt started last, idle is only reported for it */
+typedef enum {
+    AUDIO_SOURCE_NONE,
+    AUDIO_SOURCE_PCM,
+    AUDIO_SOURCE_MP3,
+    AUDIO_SOURCE_ADPCM,
+} audio_source_t;
+
+static volatile audio_source_t active_source;
+static audio_idle_cb_t idle_cb;
+
+/* Trigger to first decoded sample of MP3 prompts, the mixer measures cached prompts */
+static int64_t trigger_us;
+static volatile bool first_sample_pending;
+
+/* ADPCM prompts are decoded block by block into the mixer stream, like the MP3 player output */
+static TaskHandle_t adpcm_task;
+static portMUX_TYPE adpcm_lock = portMUX_INITIALIZER_UNLOCKED;
+static const prompt_archive_entry_t *adpcm_entry;
+static volatile uint32_t adpcm_gen;
+
 static esp_err_t bsp_audio_reconfig_clk(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
 static esp_err_t bsp_audio_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+static void audio_source_done(audio_source_t source);
+
+static void app_adpcm_stop(void)
+{
+    portENTER_CRITICAL(&adpcm_lock);
+    adpcm_entry = NULL;
+    adpcm_gen++;
+    portEXIT_CRITICAL(&adpcm_lock);
+}
+
+static void app_adpcm_play(const prompt_archive_entry_t *entry)
+{
+    portENTER_CRITICAL(&adpcm_lock);
+    adpcm_entry = entry;
+    adpcm_gen++;
+    portEXIT_CRITICAL(&adpcm_lock);
+    xTaskNotifyGive(adpcm_task);
+}
+
+static void app_adpcm_task(void *arg)
+{
+    static int16_t pcm[ADPCM_BLOCK_SAMPLES];
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        portENTER_CRITICAL(&adpcm_lock);
+        const prompt_archive_entry_t *entry = adpcm_entry;
+        uint32_t gen = adpcm_gen;
+        portEXIT_CRITICAL(&adpcm_lock);
+        if (NULL == entry) {
+            continue;
+        }
+
+        audio_mixer_stream_set_format(entry->sample_rate, 1);
+        const uint8_t *data = prompt_archive_data(entry);
+        for (uint32_t offset = 0; (offset < entry->size) && (gen == adpcm_gen); offset += ADPCM_BLOCK_SIZE) {
+            uint32_t len = MIN(entry->size - offset, ADPCM_BLOCK_SIZE);
+            size_t samples = adpcm_decode_block(data + offset, len, pcm);
+            if (0 == samples) {
+                ESP_LOGE(TAG, "%s: bad block at %d", entry->name, offset);
+                break;
+            }
+            if (first_sample_pending) {
+                first_sample_pending = false;
+                ESP_LOGI(TAG, "first sample after %lld us (adpcm)", esp_timer_get_time() - trigger_us);
+            }
+            audio_mixer_stream_write(pcm, samples * sizeof(int16_t), portMAX_DELAY);
+        }
+
+        if (gen == adpcm_gen) {
+            audio_source_done(AUDIO_SOURCE_ADPCM);
+        }
+    }
+    vTaskDelete(NULL);
+}
 
 esp_err_t audio_force_quite(bool ret)
 {
+    app_adpcm_stop();
     return audio_player_stop();
 }
 
+void audio_register_idle_cb(audio_idle_cb_t cb)
+{
+    idle_cb = cb;
+}
+
+static void audio_source_done(audio_source_t source)
+{
+    if (source == active_source) {
+        active_source = AUDIO_SOURCE_NONE;
+        if (idle_cb) {
+            idle_cb();
+        }
+    }
+}
+
 esp_err_t app_audio_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
 {
     esp_err_t ret = ESP_OK;
 
-    if (bsp_audio_write(audio_buffer, len, bytes_written, 1000) != ESP_OK) {
-        ESP_LOGE(TAG, "Write Task: i2s write failed");
+    if (first_sample_pending) {
+        first_sample_pending = false;
+        ESP_LOGI(TAG, "first sample after %lld us (mp3)", esp_timer_get_time() - trigger_us);
+    }
+
+    if (audio_mixer_stream_write(audio_buffer, len, timeout_ms) != ESP_OK) {
+        ESP_LOGE(TAG, "Write Task: stream write failed");
         ret = ESP_FAIL;
     }
+    *bytes_written = len;
 
     return ret;
 }
 
+/* The codec stays at the mixer rate, the player only tells the mixer what it decodes */
+static esp_err_t app_audio_set_clk(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    ESP_RETURN_ON_FALSE(16 == bits_cfg, ESP_ERR_NOT_SUPPORTED, TAG, "%d bit not supported", bits_cfg);
+    return audio_mixer_stream_set_format(rate, (I2S_SLOT_MODE_STEREO == ch) ? 2 : 1);
+}
+
+static void app_audio_voice_done(void)
+{
+    audio_source_done(AUDIO_SOURCE_PCM);
+}
+
+
+static const char *sound_file_name[] = {
+    [SOUND_TYPE_KNOB] = "knob_1ch.mp3",
+    [SOUND_TYPE_SNORE] = "snore_cute_1ch.mp3",
+    [SOUND_TYPE_ALARM] = "alert.mp3",
+    [SOUND_TYPE_WASH_END_CN] = "wash_end_zh_1ch.mp3",
+    [SOUND_TYPE_WASH_END_EN] = "wash_end_en_1ch.mp3",
+    [SOUND_TYPE_FACTORY] = "factory.mp3",
+    [SOUND_TYPE_LIGHT_ON] = "factory.mp3",
+    [SOUND_TYPE_LIGHT_OFF] = "factory.mp3",
+    [SOUND_TYPE_COLOR_WARM] = "Warm_Mode.mp3",
+    [SOUND_TYPE_COLOR_COOL] = "Cold_Mode.mp3",
+    [SOUND_TYPE_LIGHT_100] = "100.mp3",
+    [SOUND_TYPE_LIGHT_75] = "75.mp3",
+    [SOUND_TYPE_LIGHT_50] = "50.mp3",
+    [SOUND_TYPE_LIGHT_25] = "25.mp3",
+};
+
+/* Stop the player and drop what it has decoded, a cached prompt takes over */
+static void app_audio_stop_stream(void)
+{
+    if (AUDIO_PLAYER_STATE_PLAYING == audio_player_get_state()) {
+        audio_player_stop();
+        audio_mixer_stream_flush();
+    } else if (AUDIO_SOURCE_ADPCM == active_source) {
+        app_adpcm_stop();
+        audio_mixer_stream_flush();
+    }
+}
+
+esp_err_t audio_handle_sequence(const PDM_SOUND_TYPE *voices, int num)
+{
+    const prompt_pcm_t *prompts[AUDIO_MIXER_SEQ_MAX];
+
+    ESP_RETURN_ON_FALSE(num && (num <= AUDIO_MIXER_SEQ_MAX), ESP_ERR_INVALID_ARG, TAG, "bad sequence");
+    for (int i = 0; i < num; i++) {
+        ESP_RETURN_ON_FALSE(voices[i] < sizeof(sound_file_name) / sizeof(sound_file_name[0]), ESP_ERR_INVALID_ARG,
+                            TAG, "unknown sound %d", voices[i]);
+        prompts[i] = prompt_cache_get(sound_file_name[voices[i]]);
+        ESP_RETURN_ON_FALSE(prompts[i], ESP_ERR_NOT_SUPPORTED, TAG, "%s is not PCM", sound_file_name[voices[i]]);
+    }
+
+    ESP_LOGI(TAG, "play: %d prompts, gapless", num);
+    app_audio_stop_stream();
+    active_source = AUDIO_SOURCE_PCM;
+    return audio_mixer_voice_play(prompts, num, false);
+}
 
 esp_err_t audio_handle_info(PDM_SOUND_TYPE voice)
 {
-    char filepath[30];
     esp_err_t ret = ESP_OK;
 
-    switch (voice) {
-    case SOUND_TYPE_KNOB:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "knob_1ch.mp3");
-        break;
-    case SOUND_TYPE_SNORE:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "snore_cute_1ch.mp3");
-        break;
-    case SOUND_TYPE_WASH_END_CN:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "wash_end_zh_1ch.mp3");
-        break;
-    case SOUND_TYPE_WASH_END_EN:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "wash_end_en_1ch.mp3");
-        break;
-    case SOUND_TYPE_FACTORY:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "factory.mp3");
-        break;
-    case SOUND_TYPE_LIGHT_ON:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "factory.mp3");
-        break;
-    case SOUND_TYPE_LIGHT_OFF:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "factory.mp3");
-        break;
-    case SOUND_TYPE_COLOR_WARM:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "Warm_Mode.mp3");
-        break;
-    case SOUND_TYPE_COLOR_COOL:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "Cold_Mode.mp3");
-        break;
-    case SOUND_TYPE_LIGHT_100:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "100.mp3");
-        break;
-    case SOUND_TYPE_LIGHT_75:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "75.mp3");
-        break;
-    case SOUND_TYPE_LIGHT_50:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "50.mp3");
-        break;
-    case SOUND_TYPE_LIGHT_25:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "25.mp3");
-        break;
-    case SOUND_TYPE_ALARM:
-        sprintf(filepath, "%s/%s", CONFIG_BSP_SPIFFS_MOUNT_POINT, "alert.mp3");
-        break;
+    ESP_RETURN_ON_FALSE(voice < sizeof(sound_file_name) / sizeof(sound_file_name[0]), ESP_ERR_INVALID_ARG, TAG, "unknown sound %d", voice);
+
+    if (SOUND_TYPE_KNOB == voice) {
+        /* The click is mixed over a running prompt and never reported, only idle is passed on */
+        ret = audio_mixer_click(esp_timer_get_time());
+        if ((ESP_OK == ret) && (AUDIO_SOURCE_NONE == active_source) && idle_cb) {
+            idle_cb();
+        }
+        return ret;
+    }
+
+    const prompt_pcm_t *prompt = prompt_cache_get(sound_file_name[voice]);
+    if (prompt) {
+        ESP_LOGI(TAG, "play: %s (cached)", prompt->name);
+        app_audio_stop_stream();
+        active_source = AUDIO_SOURCE_PCM;
+        return audio_mixer_voice_play(&prompt, 1, false);
+    }
+
+    trigger_us = esp_timer_get_time();
+    first_sample_pending = true;
+
+    const prompt_archive_entry_t *entry = prompt_archive_find(sound_file_name[voice]);
+    ESP_GOTO_ON_FALSE(entry, ESP_ERR_NOT_FOUND, err, TAG, "No prompt:%s", sound_file_name[voice]);
+    if (PROMPT_FORMAT_ADPCM == entry->format) {
+        ESP_LOGI(TAG, "play: %s (adpcm)", entry->name);
+        app_audio_stop_stream();
+        audio_mixer_voice_stop();
+        active_source = AUDIO_SOURCE_ADPCM;
+        app_adpcm_play(entry);
+        return ESP_OK;
     }
-    FILE *fp = fopen(filepath, "r");
-    ESP_GOTO_ON_FALSE(fp, ESP_FAIL, err, TAG,  "Failed open file:%s", filepath);
 
-    ESP_LOGI(TAG, "play: %s", filepath);
+    FILE *fp = prompt_archive_fopen(entry);
+    ESP_GOTO_ON_FALSE(fp, ESP_FAIL, err, TAG,  "Failed open prompt:%s", entry->name);
+
+    ESP_LOGI(TAG, "play: %s", entry->name);
+    if (AUDIO_SOURCE_ADPCM == active_source) {
+        app_adpcm_stop();
+        audio_mixer_stream_flush();
+    }
+    audio_mixer_voice_stop();
+    active_source = AUDIO_SOURCE_MP3;
     ret = audio_player_play(fp);
+    if (ESP_OK != ret) {
+        active_source = AUDIO_SOURCE_NONE;
+    }
 err:
     return ret;
 }
@@ -114,12 +286,15 @@ static void audio_callback(audio_player_cb_ctx_t *ctx)
     switch (ctx->audio_event) {
     case AUDIO_PLAYER_CALLBACK_EVENT_IDLE: /**< Player is idle, not playing audio */
         ESP_LOGI(TAG, "IDLE");
+        app_event_post(APP_EVENT_PRODUCER_AUDIO, APP_EVENT_AUDIO_IDLE, 0);
+        audio_source_done(AUDIO_SOURCE_MP3);
         break;
     case AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT:
         ESP_LOGI(TAG, "NEXT");
         break;
     case AUDIO_PLAYER_CALLBACK_EVENT_PLAYING:
         ESP_LOGI(TAG, "PLAYING");
+        app_event_post(APP_EVENT_PRODUCER_AUDIO, APP_EVENT_AUDIO_PLAYING, 0);
         break;
     case AUDIO_PLAYER_CALLBACK_EVENT_PAUSE:
         ESP_LOGI(TAG, "PAUSE");
@@ -136,6 +311,24 @@ static void audio_callback(audio_player_cb_ctx_t *ctx)
     }
 }
 
+static esp_err_t codec_open(const esp_codec_dev_sample_info_t *fs)
+{
+    int64_t start = esp_timer_get_time();
+
+    if (codec_is_open) {
+        esp_codec_dev_close(play_dev_handle);
+        codec_is_open = false;
+    }
+    esp_err_t ret = esp_codec_dev_open(play_dev_handle, (esp_codec_dev_sample_info_t *)fs);
+    ESP_RETURN_ON_FALSE(ESP_CODEC_DEV_OK == ret, ESP_FAIL, TAG, "codec open failed (%d)", ret);
+
+    codec_fs = *fs;
+    codec_is_open = true;
+    ESP_LOGI(TAG, "codec open %d Hz %d bit %d ch in %lld us", fs->sample_rate, fs->bits_per_sample, fs->channel,
+             esp_timer_get_time() - start);
+    return ESP_OK;
+}
+
 static esp_err_t bsp_audio_reconfig_clk(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
 {
     esp_err_t ret = ESP_OK;
@@ -146,19 +339,107 @@ static esp_err_t bsp_audio_reconfig_clk(uint32_t rate, uint32_t bits_cfg, i2s_sl
         .bits_per_sample = bits_cfg,
     };
 
-    ret = esp_codec_dev_close(play_dev_handle);
-    ret = esp_codec_dev_open(play_dev_handle, &fs);
+    xSemaphoreTake(codec_mutex, portMAX_DELAY);
+    if (!codec_is_open || memcmp(&fs, &codec_fs, sizeof(fs))) {
+        ret = codec_open(&fs);
+    }
+    xSemaphoreGive(codec_mutex);
     return ret;
 }
 
 static esp_err_t bsp_audio_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
 {
     esp_err_t ret = ESP_OK;
-    ret = esp_codec_dev_write(play_dev_handle, audio_buffer, len);
+
+    xSemaphoreTake(codec_mutex, portMAX_DELAY);
+    if (!codec_is_open) {
+        /* Closed by the idle window, start of playback pays for the reopen */
+        ret = codec_open(&codec_fs);
+    }
+    if (ESP_OK == ret) {
+        ret = esp_codec_dev_write(play_dev_handle, audio_buffer, len);
+    }
+    xSemaphoreGive(codec_mutex);
     *bytes_written = len;
     return ret;
 }
 
+static void codec_idle_timer_cb(void *arg)
+{
+    xSemaphoreTake(codec_mutex, portMAX_DELAY);
+    if (codec_is_open) {
+        esp_codec_dev_close(play_dev_handle);
+        codec_is_open = false;
+        ESP_LOGI(TAG, "codec closed after %d ms idle", AUDIO_CODEC_IDLE_CLOSE_MS);
+    }
+    xSemaphoreGive(codec_mutex);
+}
+
+static void app_audio_mixer_idle(bool idle)
+{
+    if (0 == AUDIO_CODEC_IDLE_CLOSE_MS) {
+        return;
+    }
+
+    if (idle) {
+        esp_timer_start_once(codec_idle_timer, AUDIO_CODEC_IDLE_CLOSE_MS * 1000ULL);
+    } else {
+        esp_timer_stop(codec_idle_timer);
+    }
+}
+
+#if AUDIO_DECODE_BENCH
+/* Decode the first entry of each format completely, the cost is scaled to one second of audio */
+static void app_audio_decode_bench(void)
+{
+    static int16_t pcm[MAX_NCHAN * MAX_NGRAN * MAX_NSAMP];
+
+    for (int i = 0; i < prompt_archive_count(); i++) {
+        const prompt_archive_entry_t *entry = prompt_archive_get(i);
+        const uint8_t *data = prompt_archive_data(entry);
+        size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        size_t heap_used = 0, samples = 0;
+        uint32_t rate = entry->sample_rate;
+        int64_t start = esp_timer_get_time();
+
+        if (PROMPT_FORMAT_ADPCM == entry->format) {
+            for (uint32_t offset = 0; offset < entry->size; offset += ADPCM_BLOCK_SIZE) {
+                samples += adpcm_decode_block(data + offset, MIN(entry->size - offset, ADPCM_BLOCK_SIZE), pcm);
+            }
+        } else if (PROMPT_FORMAT_MP3 == entry->format) {
+            HMP3Decoder decoder = MP3InitDecoder();
+            if (NULL == decoder) {
+                continue;
+            }
+            heap_used = heap_before - heap_caps_get_free_size(MALLOC_CAP_8BIT);
+            unsigned char *in = (unsigned char *)data;
+            int left = entry->size;
+            MP3FrameInfo info = {0};
+            for (int offset; (left > 0) && ((offset = MP3FindSyncWord(in, left)) >= 0);) {
+                in += offset;
+                left -= offset;
+                int err = MP3Decode(decoder, &in, &left, pcm, 0);
+                if ((ERR_MP3_NONE != err) && (ERR_MP3_MAINDATA_UNDERFLOW != err)) {
+                    break;
+                }
+                MP3GetLastFrameInfo(decoder, &info);
+                samples += info.outputSamps / MAX(info.nChans, 1);
+            }
+            MP3FreeDecoder(decoder);
+            rate = info.samprate;
+        } else {
+            continue;
+        }
+
+        int64_t cost_us = esp_timer_get_time() - start;
+        if (samples && rate) {
+            ESP_LOGI(TAG, "bench %s (%s): %lld us per second of audio, %d bytes heap", entry->name,
+                     (PROMPT_FORMAT_ADPCM == entry->format) ? "adpcm" : "mp3", cost_us * rate / samples, heap_used);
+        }
+    }
+}
+#endif
+
 static void bsp_codec_init()
 {
     play_dev_handle = bsp_audio_codec_speaker_init();
@@ -170,14 +451,40 @@ esp_err_t audio_play_start()
     esp_err_t ret = ESP_OK;
 
     bsp_codec_init();
+    codec_mutex = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(codec_mutex, ESP_ERR_NO_MEM, TAG, "no mem for codec mutex");
+    const esp_timer_create_args_t timer_args = {
+        .callback = codec_idle_timer_cb,
+        .name = "codec_idle",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &codec_idle_timer), TAG, "create idle timer failed");
+
+    ESP_RETURN_ON_ERROR(bsp_audio_reconfig_clk(AUDIO_MIXER_RATE, 16, I2S_SLOT_MODE_MONO), TAG, "codec open failed");
+    ESP_RETURN_ON_ERROR(audio_mixer_init(bsp_audio_write, app_audio_voice_done, app_audio_mixer_idle), TAG,
+                        "mixer init failed");
+
+    BaseType_t ret_val = xTaskCreate(app_adpcm_task, "audio_adpcm", 2 * 1024, NULL, 5, &adpcm_task);
+    ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "create adpcm task failed");
 
     audio_player_config_t config = {
         .mute_fn = app_mute_function,
         .write_fn = app_audio_write,
-        .clk_set_fn = bsp_audio_reconfig_clk,
+        .clk_set_fn = app_audio_set_clk,
         .priority = 5
     };
     ESP_ERROR_CHECK(audio_player_new(config));
     audio_player_callback_register(audio_callback, NULL);
+    ESP_RETURN_ON_ERROR(prompt_queue_init(), TAG, "prompt queue init failed");
+
+    if (ESP_OK == prompt_archive_init()) {
+        prompt_cache_init();
+        const prompt_pcm_t *click = prompt_cache_get(sound_file_name[SOUND_TYPE_KNOB]);
+        if ((NULL == click) || (ESP_OK != audio_mixer_click_load(click))) {
+            ESP_LOGW(TAG, "no knob click");
+        }
+#if AUDIO_DECODE_BENCH
+        app_audio_decode_bench();
+#endif
+    }
     return ret;
 }
@@ -7,6 +7,18 @@
 
 #pragma once
 
+#include "esp_err.h"
+
+/* Close the codec after this long without sound, 0 keeps it open */
+#ifndef AUDIO_CODEC_IDLE_CLOSE_MS
+#define AUDIO_CODEC_IDLE_CLOSE_MS   5000
+#endif
+
+/* Set to 1 to log the decode time per second of audio and heap used for ADPCM and MP3 prompts at start */
+#ifndef AUDIO_DECODE_BENCH
+#define AUDIO_DECODE_BENCH          0
+#endif
+
 typedef enum{
     SOUND_TYPE_KNOB,
     SOUND_TYPE_SNORE,
@@ -24,8 +36,22 @@ typedef enum{
     SOUND_TYPE_LIGHT_25
 }PDM_SOUND_TYPE;
 
+/**
+ * @brief Called when the prompt started last has finished, from the audio tasks
+ */
+typedef void (*audio_idle_cb_t)(void);
+
 esp_err_t audio_force_quite(bool ret);
 
+void audio_register_idle_cb(audio_idle_cb_t cb);
+
 esp_err_t audio_handle_info(PDM_SOUND_TYPE voice);
 
+/**
+ * @brief Play cached (PCM) prompts back to back without a gap, e.g. a mode followed by a level
+ *
+ * @return ESP_ERR_NOT_SUPPORTED if one of the prompts is not available as PCM
+ */
+esp_err_t audio_handle_sequence(const PDM_SOUND_TYPE *voices, int num);
+
 esp_err_t audio_play_start();
\ No newline at end of file
@@ -0,0 +1,480 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_audio_mixer.h"
+
+static const char *TAG = "audio_mixer";
+
+#define STREAM_BUFFER_SIZE      (4 * 1024)
+#define STREAM_CHUNK_SAMPLES    128
+#define STREAM_CARRY_MAX        (AUDIO_MIXER_BLOCK_SAMPLES * 2 + 4)
+#define IDLE_SILENCE_BLOCKS     2
+
+/* Source read with a 16.16 fixed point position, linear interpolation when resampled */
+typedef struct {
+    const int16_t *pcm;
+    uint32_t samples;
+    uint32_t pos;
+    uint32_t step;
+} mixer_src_t;
+
+typedef struct {
+    const prompt_pcm_t *seq[AUDIO_MIXER_SEQ_MAX];
+    uint8_t seq_num;
+    uint8_t seq_index;
+    bool active;
+    int64_t trigger_us;
+    uint32_t gen;                   /*!< Bumped each time a play replaces the sequence */
+    mixer_src_t src;
+} mixer_voice_t;
+
+static SemaphoreHandle_t mixer_mutex;
+static TaskHandle_t mixer_task;
+static audio_mixer_write_fn_t mixer_write;
+static audio_mixer_done_cb_t mixer_voice_done_cb;
+static audio_mixer_idle_cb_t mixer_idle_cb;
+
+static mixer_voice_t voice;
+static mixer_src_t click;
+static bool click_active;
+
+/* Resident click, triggered without the mixer mutex */
+static int16_t click_pcm[AUDIO_MIXER_CLICK_SAMPLES];
+static uint32_t click_samples;
+static portMUX_TYPE click_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool click_pending;
+static int64_t click_event_us;
+static audio_mixer_click_stats_t click_stats;
+static uint64_t click_latency_sum;
+
+/* Set by the mix when a voice starts, logged by the mixer task once the block is written */
+static audio_mixer_voice_stats_t voice_stats;
+static const prompt_pcm_t *voice_started;
+
+static StreamBufferHandle_t stream_buffer;
+static volatile bool stream_flushing;
+static uint8_t stream_channels = 1;
+static uint32_t stream_step = 1 << 16;
+static int16_t stream_carry[STREAM_CARRY_MAX];
+static uint32_t stream_carry_len, stream_pos;
+
+static int32_t mix_acc[AUDIO_MIXER_BLOCK_SAMPLES];
+static int16_t mix_out[AUDIO_MIXER_BLOCK_SAMPLES];
+
+static inline uint32_t mixer_step(uint32_t rate)
+{
+    return ((uint64_t)rate << 16) / AUDIO_MIXER_RATE;
+}
+
+static void mixer_src_set(mixer_src_t *src, const prompt_pcm_t *prompt)
+{
+    src->pcm = prompt->pcm;
+    src->samples = prompt->len / sizeof(int16_t);
+    src->pos = 0;
+    src->step = mixer_step(prompt->sample_rate);
+}
+
+/* Adds up to num samples of the source, returns the number added */
+static int mixer_src_mix(mixer_src_t *src, int32_t *acc, int num)
+{
+    int i = 0;
+
+    for (; i < num; i++) {
+        uint32_t index = src->pos >> 16;
+        if (index >= src->samples) {
+            break;
+        }
+        int32_t s0 = src->pcm[index];
+        int32_t s1 = (index + 1 < src->samples) ? src->pcm[index + 1] : s0;
+        acc[i] += s0 + (((s1 - s0) * (int32_t)(src->pos & 0xFFFF)) >> 16);
+        src->pos += src->step;
+    }
+    return i;
+}
+
+/* Continues with the next prompt of the sequence within the same block, no gap */
+static bool mixer_voice_mix(int32_t *acc, int num)
+{
+    int done = 0;
+
+    while (voice.active && (done < num)) {
+        if ((0 == voice.src.pos) && voice.trigger_us) {
+            voice_stats.count++;
+            voice_stats.last_us = esp_timer_get_time() - voice.trigger_us;
+            voice_stats.max_us = MAX(voice_stats.max_us, voice_stats.last_us);
+            voice_started = voice.seq[voice.seq_index];
+            voice.trigger_us = 0;
+        }
+        done += mixer_src_mix(&voice.src, acc + done, num - done);
+        if (done < num) {
+            if (++voice.seq_index < voice.seq_num) {
+                mixer_src_set(&voice.src, voice.seq[voice.seq_index]);
+            } else {
+                voice.active = false;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void mixer_stream_mix(int32_t *acc, int num)
+{
+    size_t space = (STREAM_CARRY_MAX - stream_carry_len) * sizeof(int16_t);
+    size_t got = xStreamBufferReceive(stream_buffer, &stream_carry[stream_carry_len], space, 0);
+
+    if (stream_flushing) {
+        stream_carry_len = 0;
+        stream_pos = 0;
+        return;
+    }
+    stream_carry_len += got / sizeof(int16_t);
+
+    for (int i = 0; i < num; i++) {
+        uint32_t index = stream_pos >> 16;
+        if (index + 1 >= stream_carry_len) {
+            break;
+        }
+        int32_t s0 = stream_carry[index];
+        int32_t s1 = stream_carry[index + 1];
+        acc[i] += s0 + (((s1 - s0) * (int32_t)(stream_pos & 0xFFFF)) >> 16);
+        stream_pos += stream_step;
+    }
+
+    uint32_t consumed = MIN(stream_pos >> 16, stream_carry_len);
+    memmove(stream_carry, &stream_carry[consumed], (stream_carry_len - consumed) * sizeof(int16_t));
+    stream_carry_len -= consumed;
+    stream_pos -= consumed << 16;
+}
+
+static void mixer_saturate(const int32_t *acc, int16_t *out, int num)
+{
+    for (int i = 0; i < num; i++) {
+        int32_t v = acc[i];
+        out[i] = (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : v;
+    }
+}
+
+static bool mixer_is_active(void)
+{
+    /* A single carried sample waits for its successor to be interpolated */
+    return voice.active || click_active || click_pending || (stream_carry_len > 1) || !xStreamBufferIsEmpty(stream_buffer);
+}
+
+/* Restart the click if one was triggered, returns the time of its input event */
+static int64_t mixer_click_take(void)
+{
+    int64_t event_us = 0;
+
+    portENTER_CRITICAL(&click_lock);
+    if (click_pending) {
+        click_pending = false;
+        event_us = click_event_us;
+    }
+    portEXIT_CRITICAL(&click_lock);
+
+    if (event_us) {
+        click.pcm = click_pcm;
+        click.samples = click_samples;
+        click.pos = 0;
+        click.step = 1 << 16;
+        click_active = true;
+    }
+    return event_us;
+}
+
+static void mixer_click_latency(int64_t event_us)
+{
+    uint32_t latency_us = esp_timer_get_time() - event_us;
+
+    click_stats.count++;
+    click_stats.last_us = latency_us;
+    click_stats.max_us = MAX(click_stats.max_us, latency_us);
+    click_latency_sum += latency_us;
+    click_stats.avg_us = click_latency_sum / click_stats.count;
+    ESP_LOGD(TAG, "click: queued %u us after the event", latency_us);
+    if (0 == (click_stats.count % 16)) {
+        ESP_LOGI(TAG, "click latency: avg %u us, max %u us over %u clicks", click_stats.avg_us, click_stats.max_us,
+                 click_stats.count);
+    }
+}
+
+static void mixer_mix_block(bool *voice_done, uint32_t *voice_gen)
+{
+    memset(mix_acc, 0, sizeof(mix_acc));
+
+    xSemaphoreTake(mixer_mutex, portMAX_DELAY);
+    mixer_stream_mix(mix_acc, AUDIO_MIXER_BLOCK_SAMPLES);
+    *voice_done = mixer_voice_mix(mix_acc, AUDIO_MIXER_BLOCK_SAMPLES);
+    *voice_gen = voice.gen;
+    if (click_active && (mixer_src_mix(&click, mix_acc, AUDIO_MIXER_BLOCK_SAMPLES) < AUDIO_MIXER_BLOCK_SAMPLES)) {
+        click_active = false;
+    }
+    xSemaphoreGive(mixer_mutex);
+
+    mixer_saturate(mix_acc, mix_out, AUDIO_MIXER_BLOCK_SAMPLES);
+}
+
+static void audio_mixer_task(void *arg)
+{
+    int silence_blocks = IDLE_SILENCE_BLOCKS;
+    size_t bytes_written;
+    bool voice_done;
+    uint32_t voice_gen;
+
+    while (1) {
+        if (!mixer_is_active()) {
+            /* Leave silence in the DMA buffers instead of the tail of the last block */
+            if (silence_blocks < IDLE_SILENCE_BLOCKS) {
+                memset(mix_out, 0, sizeof(mix_out));
+                mixer_write(mix_out, sizeof(mix_out), &bytes_written, 1000);
+                if ((++silence_blocks == IDLE_SILENCE_BLOCKS) && mixer_idle_cb) {
+                    mixer_idle_cb(true);
+                }
+                continue;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if ((silence_blocks == IDLE_SILENCE_BLOCKS) && mixer_idle_cb) {
+            mixer_idle_cb(false);
+        }
+        silence_blocks = 0;
+
+        int64_t click_us = mixer_click_take();
+        mixer_mix_block(&voice_done, &voice_gen);
+        mixer_write(mix_out, sizeof(mix_out), &bytes_written, 1000);
+        if (click_us) {
+            mixer_click_latency(click_us);
+        }
+        if (voice_started) {
+            ESP_LOGI(TAG, "%s: first sample after %u us", voice_started->name, voice_stats.last_us);
+            voice_started = NULL;
+        }
+        if (voice_done && mixer_voice_done_cb) {
+            /* A play since the block was mixed replaced the finished sequence, its done is stale */
+            xSemaphoreTake(mixer_mutex, portMAX_DELAY);
+            if (voice_gen == voice.gen) {
+                mixer_voice_done_cb();
+            }
+            xSemaphoreGive(mixer_mutex);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t audio_mixer_stream_set_format(uint32_t rate, uint8_t channels)
+{
+    ESP_RETURN_ON_FALSE(rate && channels && (channels <= 2), ESP_ERR_INVALID_ARG, TAG, "bad format");
+
+    while (!xStreamBufferIsEmpty(stream_buffer) || (stream_carry_len > 1)) {
+        if (stream_flushing) {
+            xTaskNotifyGive(mixer_task);
+        }
+        vTaskDelay(pdMS_TO_TICKS(2));
+    }
+
+    xSemaphoreTake(mixer_mutex, portMAX_DELAY);
+    stream_step = mixer_step(rate);
+    stream_channels = channels;
+    stream_carry_len = 0;
+    stream_pos = 0;
+    stream_flushing = false;
+    xSemaphoreGive(mixer_mutex);
+    return ESP_OK;
+}
+
+esp_err_t audio_mixer_stream_write(const int16_t *pcm, size_t len, uint32_t timeout_ms)
+{
+    int16_t chunk[STREAM_CHUNK_SAMPLES];
+    size_t samples = len / sizeof(int16_t) / stream_channels;
+
+    while (samples && !stream_flushing) {
+        size_t num = MIN(samples, STREAM_CHUNK_SAMPLES);
+        for (int i = 0; i < num; i++) {
+            chunk[i] = (2 == stream_channels) ? ((pcm[2 * i] + pcm[2 * i + 1]) / 2) : pcm[i];
+        }
+        pcm += num * stream_channels;
+        samples -= num;
+
+        size_t sent = 0;
+        while ((sent < num * sizeof(int16_t)) && !stream_flushing) {
+            sent += xStreamBufferSend(stream_buffer, (uint8_t *)chunk + sent, num * sizeof(int16_t) - sent,
+                                      pdMS_TO_TICKS(20));
+            xTaskNotifyGive(mixer_task);
+        }
+    }
+    return ESP_OK;
+}
+
+void audio_mixer_stream_flush(void)
+{
+    stream_flushing = true;
+    xTaskNotifyGive(mixer_task);
+}
+
+esp_err_t audio_mixer_voice_play(const prompt_pcm_t *const *prompts, int num, bool append)
+{
+    ESP_RETURN_ON_FALSE(mixer_task, ESP_ERR_INVALID_STATE, TAG, "not started");
+    ESP_RETURN_ON_FALSE(num && (num <= AUDIO_MIXER_SEQ_MAX), ESP_ERR_INVALID_ARG, TAG, "bad sequence");
+
+    xSemaphoreTake(mixer_mutex, portMAX_DELAY);
+    if (append && voice.active) {
+        /* Keep the playing prompt, drop the ones already played to make room */
+        uint8_t keep = voice.seq_num - voice.seq_index;
+        memmove(voice.seq, &voice.seq[voice.seq_index], keep * sizeof(voice.seq[0]));
+        voice.seq_index = 0;
+        voice.seq_num = keep;
+        for (int i = 0; (i < num) && (voice.seq_num < AUDIO_MIXER_SEQ_MAX); i++) {
+            voice.seq[voice.seq_num++] = prompts[i];
+        }
+    } else {
+        memcpy(voice.seq, prompts, num * sizeof(voice.seq[0]));
+        voice.seq_num = num;
+        voice.seq_index = 0;
+        voice.trigger_us = esp_timer_get_time();
+        mixer_src_set(&voice.src, prompts[0]);
+        voice.active = true;
+        voice.gen++;
+    }
+    xSemaphoreGive(mixer_mutex);
+
+    xTaskNotifyGive(mixer_task);
+    return ESP_OK;
+}
+
+void audio_mixer_voice_stop(void)
+{
+    if (mixer_mutex) {
+        xSemaphoreTake(mixer_mutex, portMAX_DELAY);
+        voice.active = false;
+        xSemaphoreGive(mixer_mutex);
+    }
+}
+
+esp_err_t audio_mixer_click_load(const prompt_pcm_t *prompt)
+{
+    ESP_RETURN_ON_FALSE(prompt, ESP_ERR_INVALID_ARG, TAG, "no click");
+
+    mixer_src_t src;
+    int32_t acc[AUDIO_MIXER_BLOCK_SAMPLES];
+    uint32_t num = 0;
+
+    /* Resample once here, the mixer task then reads the click one to one */
+    mixer_src_set(&src, prompt);
+    while (num < AUDIO_MIXER_CLICK_SAMPLES) {
+        int want = MIN(AUDIO_MIXER_BLOCK_SAMPLES, AUDIO_MIXER_CLICK_SAMPLES - num);
+        memset(acc, 0, sizeof(acc));
+        int got = mixer_src_mix(&src, acc, want);
+        mixer_saturate(acc, &click_pcm[num], got);
+        num += got;
+        if (got < want) {
+            break;
+        }
+    }
+
+    if ((src.pos >> 16) < src.samples) {
+        uint32_t fade = MIN(num, 64);
+        for (int i = 0; i < fade; i++) {
+            click_pcm[num - fade + i] = click_pcm[num - fade + i] * (int32_t)(fade - i) / fade;
+        }
+        ESP_LOGW(TAG, "%s cut to %d samples", prompt->name, num);
+    }
+
+    portENTER_CRITICAL(&click_lock);
+    click_samples = num;
+    portEXIT_CRITICAL(&click_lock);
+    ESP_LOGI(TAG, "click: %s, %d samples resident", prompt->name, num);
+    return ESP_OK;
+}
+
+esp_err_t audio_mixer_click(int64_t event_us)
+{
+    ESP_RETURN_ON_FALSE(mixer_task && click_samples, ESP_ERR_INVALID_STATE, TAG, "no click");
+
+    portENTER_CRITICAL(&click_lock);
+    click_event_us = event_us ? event_us : esp_timer_get_time();
+    click_pending = true;
+    portEXIT_CRITICAL(&click_lock);
+
+    xTaskNotifyGive(mixer_task);
+    return ESP_OK;
+}
+
+void audio_mixer_get_click_stats(audio_mixer_click_stats_t *stats)
+{
+    *stats = click_stats;
+}
+
+void audio_mixer_get_voice_stats(audio_mixer_voice_stats_t *stats)
+{
+    *stats = voice_stats;
+}
+
+#if AUDIO_MIXER_BENCH
+/* Voice resampled from 44.1 kHz, click at the mixer rate and saturation, i.e. the worst case */
+static void audio_mixer_bench(void)
+{
+    const int loops = 200;
+    static int16_t bench_pcm[AUDIO_MIXER_BLOCK_SAMPLES * 2];
+
+    for (int i = 0; i < AUDIO_MIXER_BLOCK_SAMPLES * 2; i++) {
+        bench_pcm[i] = (i & 0x10) ? 30000 : -30000;
+    }
+    prompt_pcm_t bench_voice = {"bench", 44100, sizeof(bench_pcm), bench_pcm};
+    prompt_pcm_t bench_click = {"bench", AUDIO_MIXER_RATE, sizeof(bench_pcm), bench_pcm};
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < loops; i++) {
+        memset(mix_acc, 0, sizeof(mix_acc));
+        mixer_src_set(&voice.src, &bench_voice);
+        mixer_src_set(&click, &bench_click);
+        mixer_src_mix(&voice.src, mix_acc, AUDIO_MIXER_BLOCK_SAMPLES);
+        mixer_src_mix(&click, mix_acc, AUDIO_MIXER_BLOCK_SAMPLES);
+        mixer_saturate(mix_acc, mix_out, AUDIO_MIXER_BLOCK_SAMPLES);
+    }
+    int64_t cost_us = esp_timer_get_time() - start;
+    uint32_t block_ms = AUDIO_MIXER_BLOCK_SAMPLES * 1000 / AUDIO_MIXER_RATE;
+
+    ESP_LOGI(TAG, "2 sources + saturation: %lld ns per 1 ms block", cost_us * 1000 / loops / block_ms);
+    memset(&voice, 0, sizeof(voice));
+    memset(&click, 0, sizeof(click));
+}
+#endif
+
+esp_err_t audio_mixer_init(audio_mixer_write_fn_t write_fn, audio_mixer_done_cb_t voice_done_cb,
+                           audio_mixer_idle_cb_t idle_cb)
+{
+    ESP_RETURN_ON_FALSE(write_fn, ESP_ERR_INVALID_ARG, TAG, "no write function");
+    if (mixer_task) {
+        return ESP_OK;
+    }
+
+    mixer_write = write_fn;
+    mixer_voice_done_cb = voice_done_cb;
+    mixer_idle_cb = idle_cb;
+    mixer_mutex = xSemaphoreCreateMutex();
+    stream_buffer = xStreamBufferCreate(STREAM_BUFFER_SIZE, sizeof(int16_t));
+    ESP_RETURN_ON_FALSE(mixer_mutex && stream_buffer, ESP_ERR_NO_MEM, TAG, "no mem");
+
+#if AUDIO_MIXER_BENCH
+    audio_mixer_bench();
+#endif
+
+    BaseType_t ret_val = xTaskCreate(audio_mixer_task, "audio_mixer", 3 * 1024, NULL, 6, &mixer_task);
+    ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "create mixer task failed");
+    return ESP_OK;
+}
@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "app_prompt_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The codec runs at this rate all the time, sources are resampled to it */
+#define AUDIO_MIXER_RATE            48000
+
+/* 5 ms per block */
+#define AUDIO_MIXER_BLOCK_SAMPLES   (AUDIO_MIXER_RATE / 200)
+
+/* Prompts queued for gapless playback on the voice channel */
+#define AUDIO_MIXER_SEQ_MAX         4
+
+/* Resident click, longer sounds are cut with a short fade out */
+#ifndef AUDIO_MIXER_CLICK_SAMPLES
+#define AUDIO_MIXER_CLICK_SAMPLES   960
+#endif
+
+/* Set to 1 to log the mixing cost per 1 ms of audio at init */
+#ifndef AUDIO_MIXER_BENCH
+#define AUDIO_MIXER_BENCH           0
+#endif
+
+/**
+ * @brief Writes one block of 16 bit mono PCM at AUDIO_MIXER_RATE to the codec
+ */
+typedef esp_err_t (*audio_mixer_write_fn_t)(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+
+/**
+ * @brief Called from the mixer task when the voice channel has played its last prompt
+ *
+ * @note Called with the mixer lock held, must not call back into the audio_mixer_* API.
+ */
+typedef void (*audio_mixer_done_cb_t)(void);
+
+/**
+ * @brief Called from the mixer task when it stops (idle true) or starts writing blocks
+ */
+typedef void (*audio_mixer_idle_cb_t)(bool idle);
+
+/**
+ * @brief Start the mixer task
+ *
+ * @note The codec must already be opened at AUDIO_MIXER_RATE, 16 bit mono.
+ */
+esp_err_t audio_mixer_init(audio_mixer_write_fn_t write_fn, audio_mixer_done_cb_t voice_done_cb,
+                           audio_mixer_idle_cb_t idle_cb);
+
+/**
+ * @brief Set the format of the following stream data, waits until the buffered data is played
+ */
+esp_err_t audio_mixer_stream_set_format(uint32_t rate, uint8_t channels);
+
+/**
+ * @brief Queue 16 bit PCM of the stream channel (MP3 player output), blocks while the buffer is full
+ */
+esp_err_t audio_mixer_stream_write(const int16_t *pcm, size_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Drop buffered and in-flight stream data until the next audio_mixer_stream_set_format()
+ */
+void audio_mixer_stream_flush(void);
+
+/**
+ * @brief Play prompts back to back on the voice channel
+ *
+ * @param prompts Prompts to play, they must stay valid while playing
+ * @param num Number of prompts, at most AUDIO_MIXER_SEQ_MAX
+ * @param append Queue after the running sequence instead of replacing it
+ */
+esp_err_t audio_mixer_voice_play(const prompt_pcm_t *const *prompts, int num, bool append);
+
+/**
+ * @brief Stop the voice channel without reporting it as done
+ */
+void audio_mixer_voice_stop(void);
+
+/**
+ * @brief Latency of the click channel, from the input event to its first block queued to the codec
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+} audio_mixer_click_stats_t;
+
+/**
+ * @brief Latency of the voice channel, from audio_mixer_voice_play() to the first sample mixed
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+} audio_mixer_voice_stats_t;
+
+/**
+ * @brief Copy a short sound into the resident click buffer, resampled to AUDIO_MIXER_RATE
+ */
+esp_err_t audio_mixer_click_load(const prompt_pcm_t *prompt);
+
+/**
+ * @brief Mix the resident click over whatever is playing, restarts a running click
+ *
+ * Takes no lock and can be called from any task, the mixer task picks it up in its next block.
+ *
+ * @param event_us esp_timer time of the input event, used for the latency statistics
+ */
+esp_err_t audio_mixer_click(int64_t event_us);
+
+/**
+ * @brief Get the click latency statistics
+ */
+void audio_mixer_get_click_stats(audio_mixer_click_stats_t *stats);
+
+/**
+ * @brief Get the voice latency statistics
+ */
+void audio_mixer_get_voice_stats(audio_mixer_voice_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,36 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "esp_check.h"
+#include "esp_console.h"
+#include "esp_log.h"
+
+#include "app_console.h"
+#include "lv_input_replay.h"
+#include "lv_latency_trace.h"
+
+static const char *TAG = "console";
+
+esp_err_t app_console_start(void)
+{
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = APP_CONSOLE_PROMPT;
+
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl), TAG, "new repl failed");
+#else
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_console_new_repl_uart(&hw_config, &repl_config, &repl), TAG, "new repl failed");
+#endif
+
+    ESP_RETURN_ON_ERROR(esp_console_register_help_command(), TAG, "help command failed");
+    ESP_RETURN_ON_ERROR(lv_latency_trace_register_cmd(), TAG, "latency command failed");
+    ESP_RETURN_ON_ERROR(lv_input_replay_register_cmd(), TAG, "replay command failed");
+
+    return esp_console_start_repl(repl);
+}
@@ -0,0 +1,29 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set to 1 to start a serial console with the commands of the enabled debug options */
+#ifndef APP_CONSOLE_ENABLE
+#define APP_CONSOLE_ENABLE      0
+#endif
+
+#define APP_CONSOLE_PROMPT      "knob> "
+
+/**
+ * @brief Register the commands and start the console task on the default console port
+ */
+esp_err_t app_console_start(void);
+
+#ifdef __cplusplus
+}
+#endif
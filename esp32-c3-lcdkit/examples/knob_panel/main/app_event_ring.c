@@ -0,0 +1,162 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "lvgl.h"
+
+#include "app_event_ring.h"
+
+static const char *TAG = "event_ring";
+
+#define RING_MASK   (APP_EVENT_RING_LEN - 1)
+
+_Static_assert((APP_EVENT_RING_LEN & RING_MASK) == 0, "APP_EVENT_RING_LEN must be a power of two");
+
+static app_event_ring_t rings[APP_EVENT_PRODUCER_MAX];
+static app_event_handler_t handlers[APP_EVENT_TYPE_MAX];
+static lv_timer_t *drain_timer;
+
+/* The C3 has no atomic instructions, the ring only needs ordered loads and stores of its indexes */
+bool IRAM_ATTR app_event_ring_push(app_event_ring_t *ring, const app_event_t *event)
+{
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= APP_EVENT_RING_LEN) {
+        ring->overflow++;
+        return false;
+    }
+    ring->buf[head & RING_MASK] = *event;
+    /* Counted before the release, a consumer which sees the event also sees the count */
+    ring->posted++;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool app_event_ring_pop(app_event_ring_t *ring, app_event_t *event)
+{
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+    *event = ring->buf[tail & RING_MASK];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+bool IRAM_ATTR app_event_post(app_event_producer_t producer, app_event_type_t type, uint32_t arg)
+{
+    if (producer >= APP_EVENT_PRODUCER_MAX) {
+        return false;
+    }
+
+    const app_event_t event = {
+        .type = type,
+        .producer = producer,
+        .arg = arg,
+    };
+    return app_event_ring_push(&rings[producer], &event);
+}
+
+static void app_event_drain_cb(lv_timer_t *tmr)
+{
+    app_event_t event;
+
+    for (int i = 0; i < APP_EVENT_PRODUCER_MAX; i++) {
+        app_event_ring_t *ring = &rings[i];
+        unsigned int pending = atomic_load_explicit(&ring->head, memory_order_acquire) -
+                               atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        ring->high_water = MAX(ring->high_water, pending);
+
+        /* Only what is pending now, a busy producer can't keep the LVGL task here */
+        while (pending-- && app_event_ring_pop(ring, &event)) {
+            if ((event.type < APP_EVENT_TYPE_MAX) && handlers[event.type]) {
+                handlers[event.type](&event);
+            }
+        }
+    }
+}
+
+void app_event_subscribe(app_event_type_t type, app_event_handler_t handler)
+{
+    if (type < APP_EVENT_TYPE_MAX) {
+        handlers[type] = handler;
+    }
+}
+
+void app_event_get_stats(app_event_producer_t producer, app_event_stats_t *stats)
+{
+    if (producer < APP_EVENT_PRODUCER_MAX) {
+        stats->posted = rings[producer].posted;
+        stats->overflow = rings[producer].overflow;
+        stats->high_water = rings[producer].high_water;
+    }
+}
+
+#if APP_EVENT_RING_SELFTEST
+#define SELFTEST_EVENTS     20000
+
+static app_event_ring_t test_ring;
+
+static void selftest_producer_task(void *arg)
+{
+    for (uint32_t seq = 0; seq < SELFTEST_EVENTS;) {
+        const app_event_t event = {.arg = seq};
+        if (app_event_ring_push(&test_ring, &event)) {
+            seq++;
+        } else {
+            taskYIELD();
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+static void selftest_consumer_task(void *arg)
+{
+    uint32_t expected = 0, out_of_order = 0;
+    app_event_t event;
+
+    while (expected < SELFTEST_EVENTS) {
+        if (!app_event_ring_pop(&test_ring, &event)) {
+            taskYIELD();
+            continue;
+        }
+        if (event.arg != expected) {
+            out_of_order++;
+        }
+        expected = event.arg + 1;
+    }
+
+    bool ok = (0 == out_of_order) && (SELFTEST_EVENTS == test_ring.posted);
+    ESP_LOGI(TAG, "selftest: %u events, %u out of order, %u times full: %s",
+             test_ring.posted, out_of_order, test_ring.overflow, ok ? "ok" : "FAIL");
+    vTaskDelete(NULL);
+}
+#endif
+
+esp_err_t app_event_init(void)
+{
+    if (drain_timer) {
+        return ESP_OK;
+    }
+
+    drain_timer = lv_timer_create(app_event_drain_cb, APP_EVENT_DRAIN_PERIOD_MS, NULL);
+    ESP_RETURN_ON_FALSE(drain_timer, ESP_ERR_NO_MEM, TAG, "no mem for timer");
+
+#if APP_EVENT_RING_SELFTEST
+    /* Same priority, the producer and consumer preempt each other on every tick */
+    xTaskCreate(selftest_consumer_task, "event_test_c", 2048, NULL, 2, NULL);
+    xTaskCreate(selftest_producer_task, "event_test_p", 2048, NULL, 2, NULL);
+#endif
+    return ESP_OK;
+}
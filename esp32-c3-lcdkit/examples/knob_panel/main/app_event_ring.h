@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Events one producer can have pending, a power of two */
+#define APP_EVENT_RING_LEN          16
+
+/* The LVGL timer draining the rings runs with this period */
+#define APP_EVENT_DRAIN_PERIOD_MS   10
+
+/* Set to 1 to run a two task stress test of the ring at init, checking order and loss */
+#ifndef APP_EVENT_RING_SELFTEST
+#define APP_EVENT_RING_SELFTEST     0
+#endif
+
+/**
+ * @brief Tasks or ISRs posting events, each has its own ring and must only post from one context
+ */
+typedef enum {
+    APP_EVENT_PRODUCER_IR,          /*!< NEC receive task */
+    APP_EVENT_PRODUCER_AUDIO,       /*!< Audio player task */
+    APP_EVENT_PRODUCER_MAX,
+} app_event_producer_t;
+
+typedef enum {
+    APP_EVENT_IR_TEST_OK,           /*!< The own NEC code was received back, arg: command */
+    APP_EVENT_AUDIO_PLAYING,        /*!< The MP3 player started a prompt */
+    APP_EVENT_AUDIO_IDLE,           /*!< The MP3 player stopped */
+    APP_EVENT_TYPE_MAX,
+} app_event_type_t;
+
+typedef struct {
+    uint16_t type;                  /*!< app_event_type_t */
+    uint16_t producer;
+    uint32_t arg;
+} app_event_t;
+
+/**
+ * @brief Single producer, single consumer ring: head is only written by the producer, tail by the consumer
+ */
+typedef struct {
+    atomic_uint head;
+    atomic_uint tail;
+    uint32_t posted;                /*!< Producer side */
+    uint32_t overflow;              /*!< Producer side, events dropped because the ring was full */
+    uint32_t high_water;            /*!< Consumer side, most events pending at a drain */
+    app_event_t buf[APP_EVENT_RING_LEN];
+} app_event_ring_t;
+
+typedef struct {
+    uint32_t posted;
+    uint32_t overflow;
+    uint32_t high_water;
+} app_event_stats_t;
+
+/**
+ * @brief Called from the LVGL task with the display lock held
+ */
+typedef void (*app_event_handler_t)(const app_event_t *event);
+
+/**
+ * @brief Create the LVGL timer draining the rings
+ *
+ * @note Call with the display locked and before lv_create_clock(), which deletes timers created later.
+ */
+esp_err_t app_event_init(void);
+
+/**
+ * @brief Post an event without locking, also from an ISR
+ *
+ * @return false if the ring of the producer is full, the event is counted as overflow
+ */
+bool app_event_post(app_event_producer_t producer, app_event_type_t type, uint32_t arg);
+
+/**
+ * @brief Set the handler of an event type, replaces the previous one, NULL drops the events
+ */
+void app_event_subscribe(app_event_type_t type, app_event_handler_t handler);
+
+void app_event_get_stats(app_event_producer_t producer, app_event_stats_t *stats);
+
+/* Ring primitives, app_event_post() and the drain timer use the ring of each producer */
+bool app_event_ring_push(app_event_ring_t *ring, const app_event_t *event);
+
+bool app_event_ring_pop(app_event_ring_t *ring, app_event_t *event);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,177 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_led_fx.h"
+
+static const char *TAG = "led_fx";
+
+#define FX_RED      {0xFF, 0x00, 0x00}
+#define FX_BLUE     {0x00, 0x00, 0xFF}
+#define FX_WHITE    {0xFF, 0xFF, 0xFF}
+#define FX_BLACK    {0x00, 0x00, 0x00}
+
+static const led_fx_key_t alarm_keys[] = {
+    {FX_RED, 0, 100},
+    {FX_BLUE, 0, 100},
+};
+
+const led_fx_t led_fx_alarm = {alarm_keys, sizeof(alarm_keys) / sizeof(alarm_keys[0]), true};
+
+static const led_fx_key_t breathe_keys[] = {
+    {FX_WHITE, 1000, 0},
+    {FX_BLACK, 1000, 0},
+};
+
+const led_fx_t led_fx_breathe = {breathe_keys, sizeof(breathe_keys) / sizeof(breathe_keys[0]), true};
+
+static led_fx_hal_set_t fx_hal_set;
+static esp_timer_handle_t fx_timer;
+static SemaphoreHandle_t fx_mutex;
+static uint8_t gamma_lut[256];
+
+/* Running effect, the current key and the color it started from */
+static const led_fx_t *fx_run;
+static uint8_t fx_index;
+static uint32_t fx_elapsed_ms;
+static led_fx_color_t fx_from;
+static led_fx_color_t fx_now;
+
+/* Single key effect of led_fx_fade_to() */
+static led_fx_key_t fade_key;
+static const led_fx_t fade_fx = {&fade_key, 1, false};
+
+static void led_fx_write(led_fx_color_t color)
+{
+#if LED_FX_TRACE
+    ESP_LOGI(TAG, "%lld ms: %02x %02x %02x", esp_timer_get_time() / 1000, color.r, color.g, color.b);
+#endif
+    fx_now = color;
+    fx_hal_set(gamma_lut[color.r], gamma_lut[color.g], gamma_lut[color.b]);
+}
+
+static inline uint8_t led_fx_lerp(uint8_t from, uint8_t to, uint32_t pos, uint32_t len)
+{
+    return from + ((int32_t)to - from) * (int32_t)pos / (int32_t)len;
+}
+
+static void led_fx_timer_cb(void *arg)
+{
+    xSemaphoreTake(fx_mutex, portMAX_DELAY);
+    if (NULL == fx_run) {
+        esp_timer_stop(fx_timer);
+        xSemaphoreGive(fx_mutex);
+        return;
+    }
+
+    const led_fx_key_t *key = &fx_run->keys[fx_index];
+    led_fx_color_t color = key->color;
+
+    fx_elapsed_ms += LED_FX_PERIOD_MS;
+    if (fx_elapsed_ms < key->fade_ms) {
+        color.r = led_fx_lerp(fx_from.r, key->color.r, fx_elapsed_ms, key->fade_ms);
+        color.g = led_fx_lerp(fx_from.g, key->color.g, fx_elapsed_ms, key->fade_ms);
+        color.b = led_fx_lerp(fx_from.b, key->color.b, fx_elapsed_ms, key->fade_ms);
+    }
+    if ((color.r != fx_now.r) || (color.g != fx_now.g) || (color.b != fx_now.b)) {
+        led_fx_write(color);
+    }
+
+    if (fx_elapsed_ms >= key->fade_ms + key->hold_ms) {
+        fx_from = key->color;
+        fx_elapsed_ms = 0;
+        if (++fx_index >= fx_run->num) {
+            fx_index = 0;
+            if (!fx_run->loop) {
+                fx_run = NULL;
+                esp_timer_stop(fx_timer);
+            }
+        }
+    }
+    xSemaphoreGive(fx_mutex);
+}
+
+esp_err_t led_fx_init(led_fx_hal_set_t set_fn)
+{
+    ESP_RETURN_ON_FALSE(set_fn, ESP_ERR_INVALID_ARG, TAG, "no LED function");
+    if (fx_timer) {
+        return ESP_OK;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        gamma_lut[i] = lroundf(powf(i / 255.0f, LED_FX_GAMMA) * 255.0f);
+    }
+
+    fx_hal_set = set_fn;
+    fx_mutex = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(fx_mutex, ESP_ERR_NO_MEM, TAG, "no mem for mutex");
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = led_fx_timer_cb,
+        .name = "led_fx",
+    };
+    return esp_timer_create(&timer_args, &fx_timer);
+}
+
+esp_err_t led_fx_play(const led_fx_t *fx)
+{
+    ESP_RETURN_ON_FALSE(fx_timer, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(fx && fx->keys && fx->num, ESP_ERR_INVALID_ARG, TAG, "empty effect");
+
+    xSemaphoreTake(fx_mutex, portMAX_DELAY);
+    fx_run = fx;
+    fx_index = 0;
+    fx_elapsed_ms = 0;
+    fx_from = fx_now;
+
+    /* Keys without a fade take effect now, not one period later */
+    if (0 == fx->keys[0].fade_ms) {
+        led_fx_write(fx->keys[0].color);
+    }
+    if (!esp_timer_is_active(fx_timer)) {
+        esp_timer_start_periodic(fx_timer, LED_FX_PERIOD_MS * 1000);
+    }
+    xSemaphoreGive(fx_mutex);
+    return ESP_OK;
+}
+
+esp_err_t led_fx_fade_to(uint8_t r, uint8_t g, uint8_t b, uint16_t fade_ms)
+{
+    ESP_RETURN_ON_FALSE(fx_timer, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    if (0 == fade_ms) {
+        return led_fx_set(r, g, b);
+    }
+
+    xSemaphoreTake(fx_mutex, portMAX_DELAY);
+    fade_key.color = (led_fx_color_t) {r, g, b};
+    fade_key.fade_ms = fade_ms;
+    fade_key.hold_ms = 0;
+    xSemaphoreGive(fx_mutex);
+    return led_fx_play(&fade_fx);
+}
+
+esp_err_t led_fx_set(uint8_t r, uint8_t g, uint8_t b)
+{
+    ESP_RETURN_ON_FALSE(fx_timer, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    xSemaphoreTake(fx_mutex, portMAX_DELAY);
+    fx_run = NULL;
+    led_fx_write((led_fx_color_t) {r, g, b});
+    xSemaphoreGive(fx_mutex);
+    return ESP_OK;
+}
+
+bool led_fx_is_running(void)
+{
+    return NULL != fx_run;
+}
@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One esp_timer steps every running effect with this period */
+#define LED_FX_PERIOD_MS        20
+
+/* Colors are given perceptually, the output is gamma corrected with this exponent, 1.0 turns it off */
+#ifndef LED_FX_GAMMA
+#define LED_FX_GAMMA            2.2f
+#endif
+
+/* Set to 1 to log every color written to the LED with its time, e.g. to check effect timings */
+#ifndef LED_FX_TRACE
+#define LED_FX_TRACE            0
+#endif
+
+/**
+ * @brief Writes a color to the LED, bsp_led_rgb_set() on the board
+ */
+typedef esp_err_t (*led_fx_hal_set_t)(uint8_t r, uint8_t g, uint8_t b);
+
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} led_fx_color_t;
+
+/**
+ * @brief Fade linearly from the previous color to color in fade_ms, then hold it for hold_ms
+ */
+typedef struct {
+    led_fx_color_t color;
+    uint16_t fade_ms;
+    uint16_t hold_ms;
+} led_fx_key_t;
+
+typedef struct {
+    const led_fx_key_t *keys;
+    uint8_t num;
+    bool loop;                  /*!< Restart after the last key until stopped, otherwise keep its color */
+} led_fx_t;
+
+/* Red / blue at 5 Hz, the light timer alarm */
+extern const led_fx_t led_fx_alarm;
+
+/* White breathing at 0.5 Hz */
+extern const led_fx_t led_fx_breathe;
+
+/**
+ * @brief Create the effect timer
+ *
+ * @param set_fn Writes a gamma corrected color to the LED
+ */
+esp_err_t led_fx_init(led_fx_hal_set_t set_fn);
+
+/**
+ * @brief Start an effect from the current color, replaces the running one
+ *
+ * @note The effect must stay valid while it runs.
+ */
+esp_err_t led_fx_play(const led_fx_t *fx);
+
+/**
+ * @brief Fade from the current color to a color and keep it
+ */
+esp_err_t led_fx_fade_to(uint8_t r, uint8_t g, uint8_t b, uint16_t fade_ms);
+
+/**
+ * @brief Stop the running effect and set a color at once
+ */
+esp_err_t led_fx_set(uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * @brief Whether an effect is running
+ */
+bool led_fx_is_running(void);
+
+#ifdef __cplusplus
+}
+#endif
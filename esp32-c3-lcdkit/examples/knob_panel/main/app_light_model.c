@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "esp_log.h"
+
+#include "app_led_fx.h"
+#include "app_light_model.h"
+
+static const char *TAG = "light_model";
+
+/* Perceptual white point per CCT step and Q16 scale per level */
+static light_rgb_t cct_lut[LIGHT_CCT_COOL + 1];
+static uint32_t level_lut[LIGHT_LEVEL_MAX + 1];
+
+static float light_model_channel(uint32_t warm, uint32_t cool, int shift, float t)
+{
+    /* Mix in linear light, back to the perceptual scale LED_FX_GAMMA is applied to */
+    float w = powf(((warm >> shift) & 0xFF) / 255.0f, LED_FX_GAMMA);
+    float c = powf(((cool >> shift) & 0xFF) / 255.0f, LED_FX_GAMMA);
+    return powf(w + (c - w) * t, 1.0f / LED_FX_GAMMA) * 255.0f;
+}
+
+#if LIGHT_MODEL_SELFTEST
+static void light_model_selftest(void)
+{
+    float err_max = 0;
+
+    for (int cct = 0; cct <= LIGHT_CCT_COOL; cct++) {
+        for (int level = 0; level <= LIGHT_LEVEL_MAX; level++) {
+            light_rgb_t rgb = light_model_rgb(level, cct);
+            float t = (float)cct / LIGHT_CCT_COOL;
+            float k = (float)level / LIGHT_LEVEL_MAX;
+            float ref[3] = {
+                light_model_channel(LIGHT_WARM_RGB, LIGHT_COOL_RGB, 16, t) * k,
+                light_model_channel(LIGHT_WARM_RGB, LIGHT_COOL_RGB, 8, t) * k,
+                light_model_channel(LIGHT_WARM_RGB, LIGHT_COOL_RGB, 0, t) * k,
+            };
+            err_max = fmaxf(err_max, fabsf(ref[0] - rgb.r));
+            err_max = fmaxf(err_max, fabsf(ref[1] - rgb.g));
+            err_max = fmaxf(err_max, fabsf(ref[2] - rgb.b));
+        }
+    }
+    ESP_LOGI(TAG, "selftest: max error %.2f LSB against float, tolerance %.2f: %s", err_max,
+             LIGHT_MODEL_TOLERANCE, (err_max <= LIGHT_MODEL_TOLERANCE) ? "ok" : "FAIL");
+}
+#endif
+
+esp_err_t light_model_init(void)
+{
+    for (int cct = 0; cct <= LIGHT_CCT_COOL; cct++) {
+        float t = (float)cct / LIGHT_CCT_COOL;
+        cct_lut[cct].r = lroundf(light_model_channel(LIGHT_WARM_RGB, LIGHT_COOL_RGB, 16, t));
+        cct_lut[cct].g = lroundf(light_model_channel(LIGHT_WARM_RGB, LIGHT_COOL_RGB, 8, t));
+        cct_lut[cct].b = lroundf(light_model_channel(LIGHT_WARM_RGB, LIGHT_COOL_RGB, 0, t));
+    }
+    for (int level = 0; level <= LIGHT_LEVEL_MAX; level++) {
+        level_lut[level] = (level * 65536 + LIGHT_LEVEL_MAX / 2) / LIGHT_LEVEL_MAX;
+    }
+
+#if LIGHT_MODEL_SELFTEST
+    light_model_selftest();
+#endif
+    return ESP_OK;
+}
+
+light_rgb_t light_model_rgb(uint8_t level, uint8_t cct)
+{
+    level = (level > LIGHT_LEVEL_MAX) ? LIGHT_LEVEL_MAX : level;
+    cct = (cct > LIGHT_CCT_COOL) ? LIGHT_CCT_COOL : cct;
+
+    const light_rgb_t *white = &cct_lut[cct];
+    uint32_t scale = level_lut[level];
+    light_rgb_t rgb = {
+        .r = (white->r * scale + 0x8000) >> 16,
+        .g = (white->g * scale + 0x8000) >> 16,
+        .b = (white->b * scale + 0x8000) >> 16,
+    };
+    return rgb;
+}
@@ -0,0 +1,54 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIGHT_LEVEL_MAX         100
+#define LIGHT_CCT_WARM          0
+#define LIGHT_CCT_COOL          100
+
+/* White points of the two ends, perceptual 8 bit RGB */
+#define LIGHT_WARM_RGB          0xFFFF33
+#define LIGHT_COOL_RGB          0xFFFFFF
+
+/* Set to 1 to check the tables against the float model at init and log the largest error */
+#ifndef LIGHT_MODEL_SELFTEST
+#define LIGHT_MODEL_SELFTEST    0
+#endif
+/* Largest error per channel the selftest accepts, two roundings of half an LSB each */
+#define LIGHT_MODEL_TOLERANCE   1.0f
+
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} light_rgb_t;
+
+/**
+ * @brief Build the CCT and level tables, the CCT ends are mixed in linear light
+ */
+esp_err_t light_model_init(void);
+
+/**
+ * @brief Color of the light, to be gamma corrected on output (see app_led_fx.h)
+ *
+ * Fixed point table lookups only, no division.
+ *
+ * @param level Brightness 0 - LIGHT_LEVEL_MAX in 1% steps, perceptually linear
+ * @param cct Color temperature from LIGHT_CCT_WARM to LIGHT_CCT_COOL
+ */
+light_rgb_t light_model_rgb(uint8_t level, uint8_t cct);
+
+#ifdef __cplusplus
+}
+#endif
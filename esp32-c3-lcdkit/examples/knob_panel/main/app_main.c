@@ -16,8 +16,17 @@
 #include "esp_log.h"
 
 #include "app_audio.h"
+#include "app_console.h"
+#include "app_event_ring.h"
+#include "app_led_fx.h"
+#include "app_light_model.h"
+#include "app_state.h"
 #include "settings.h"
 #include "lv_example_pub.h"
+#include "lv_frame_check.h"
+#include "lv_draw_rv32.h"
+#include "lv_frame_monitor.h"
+#include "lv_latency_trace.h"
 #include "bsp/esp-bsp.h"
 
 static const char *TAG = "main";
@@ -25,6 +34,26 @@ static const char *TAG = "main";
 
 #define MEMORY_MONITOR 0
 
+/* LVGL draw buffer strategy */
+#define DISP_BUF_BSP_DEFAULT    0   /* whatever bsp_display_start() allocates */
+#define DISP_BUF_STRIP          1   /* DISP_BUF_STRIP_H lines, single or double buffered */
+#define DISP_BUF_FULL_FRAME     2   /* one buffer of the whole screen, strips if RAM is short */
+
+#ifndef DISP_BUF_STRATEGY
+#define DISP_BUF_STRATEGY       DISP_BUF_BSP_DEFAULT
+#endif
+#ifndef DISP_BUF_STRIP_H
+#define DISP_BUF_STRIP_H        20
+#endif
+#ifndef DISP_BUF_DOUBLE
+#define DISP_BUF_DOUBLE         1
+#endif
+
+/* Log flush count, bytes per flush and buffer wait time every 5 s */
+#ifndef DISP_BUF_REPORT
+#define DISP_BUF_REPORT         0
+#endif
+
 #if MEMORY_MONITOR
 
 #define ARRAY_SIZE_OFFSET   5   //Increase this if print_real_time_stats returns ESP_ERR_INVALID_SIZE
@@ -175,10 +204,51 @@ static void sys_monitor_start(void)
 #endif
 
 
+static lv_disp_t *display_start(void)
+{
+#if DISP_BUF_STRATEGY == DISP_BUF_BSP_DEFAULT
+    return bsp_display_start();
+#else
+    bsp_display_cfg_t cfg = {
+        .lvgl_port_cfg = ESP_LVGL_PORT_INIT_CONFIG(),
+        .buffer_size = BSP_LCD_H_RES * DISP_BUF_STRIP_H,
+        .double_buffer = DISP_BUF_DOUBLE,
+    };
+#if DISP_BUF_STRATEGY == DISP_BUF_FULL_FRAME
+    size_t frame_size = BSP_LCD_H_RES * BSP_LCD_V_RES * sizeof(lv_color_t);
+    if (heap_caps_get_largest_free_block(MALLOC_CAP_DMA) > frame_size) {
+        cfg.buffer_size = BSP_LCD_H_RES * BSP_LCD_V_RES;
+        cfg.double_buffer = false;
+    } else {
+        ESP_LOGW(TAG, "No room for a %d byte frame buffer, use %d line strips", frame_size, DISP_BUF_STRIP_H);
+    }
+#endif
+    ESP_LOGI(TAG, "Draw buffer %d lines x%d", cfg.buffer_size / BSP_LCD_H_RES, cfg.double_buffer ? 2 : 1);
+    return bsp_display_start_with_config(&cfg);
+#endif
+}
+
+#if DISP_BUF_REPORT
+static void disp_buf_report_cb(lv_timer_t *tmr)
+{
+    static const char *strategy_name[] = {"bsp default", "strip", "full frame"};
+
+    lv_frame_monitor_report(strategy_name[DISP_BUF_STRATEGY]);
+    lv_frame_monitor_reset();
+}
+#endif
+
+/* A prompt keeps the screen from falling back to the clock, like a knob turn */
+static void audio_playing_event_cb(const app_event_t *event)
+{
+    feed_clock_time();
+}
+
 esp_err_t bsp_board_init(void)
 {
     ESP_ERROR_CHECK(bsp_led_init());
-    ESP_ERROR_CHECK(bsp_spiffs_mount());
+    ESP_ERROR_CHECK(led_fx_init(bsp_led_rgb_set));
+    ESP_ERROR_CHECK(light_model_init());
     return ESP_OK;
 }
 
@@ -193,11 +263,22 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(err);
     ESP_ERROR_CHECK(settings_read_parameter_from_nvs());
+    /* Without the journal the screens still work, their state is then lost on reboot */
+    ESP_ERROR_CHECK_WITHOUT_ABORT(app_state_init());
 
-    bsp_display_start();
+    lv_disp_t *disp = display_start();
+    lv_draw_rv32_init(disp);
+#if DISP_BUF_REPORT
+    lv_frame_monitor_init(disp);
+    lv_timer_create(disp_buf_report_cb, 5000, NULL);
+#endif
 
     ESP_LOGI(TAG, "Display LVGL demo");
     ui_obj_to_encoder_init();
+    ESP_ERROR_CHECK(app_event_init());
+    app_event_subscribe(APP_EVENT_AUDIO_PLAYING, audio_playing_event_cb);
+    lv_frame_check_start(disp);
+    lv_latency_trace_init(disp);
     lv_create_home(&boot_Layer);
     lv_create_clock(&clock_screen_layer, TIME_ENTER_CLOCK_2MIN);
     bsp_display_unlock();
@@ -207,6 +288,9 @@ void app_main(void)
 
     bsp_board_init();
     audio_play_start();
+#if APP_CONSOLE_ENABLE
+    ESP_ERROR_CHECK(app_console_start());
+#endif
 
 #if MEMORY_MONITOR
     sys_monitor_start();
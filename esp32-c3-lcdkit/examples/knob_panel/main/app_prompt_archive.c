@@ -0,0 +1,246 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_vfs.h"
+
+#include "app_prompt_archive.h"
+
+static const char *TAG = "prompt_archive";
+
+/* Open file of the VFS interface, the data is read from the mapping */
+typedef struct {
+    const prompt_archive_entry_t *entry;
+    uint32_t pos;
+} archive_file_t;
+
+static const uint8_t *archive_base;
+static const prompt_archive_header_t *archive_header;
+static const prompt_archive_entry_t *archive_entries;
+static const uint16_t *archive_slots;
+static esp_partition_mmap_handle_t archive_mmap;
+
+static archive_file_t archive_files[PROMPT_ARCHIVE_MAX_FILES];
+static portMUX_TYPE archive_files_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* FNV-1a over the name, must match tools/pack_prompts.py */
+static uint32_t archive_hash(uint32_t seed, const char *name)
+{
+    uint32_t h = 2166136261UL ^ seed;
+
+    for (int i = 0; (i < PROMPT_ARCHIVE_NAME_LEN) && name[i]; i++) {
+        h = (h ^ (uint8_t)name[i]) * 16777619UL;
+    }
+    return h;
+}
+
+static int archive_vfs_open(const char *path, int flags, int mode)
+{
+    if (O_RDONLY != (flags & O_ACCMODE)) {
+        errno = EROFS;
+        return -1;
+    }
+
+    const prompt_archive_entry_t *entry = prompt_archive_find(('/' == path[0]) ? path + 1 : path);
+    if (NULL == entry) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    int fd = -1;
+    portENTER_CRITICAL(&archive_files_lock);
+    for (int i = 0; i < PROMPT_ARCHIVE_MAX_FILES; i++) {
+        if (NULL == archive_files[i].entry) {
+            archive_files[i].entry = entry;
+            archive_files[i].pos = 0;
+            fd = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&archive_files_lock);
+
+    if (fd < 0) {
+        errno = ENFILE;
+    }
+    return fd;
+}
+
+static ssize_t archive_vfs_read(int fd, void *dst, size_t size)
+{
+    archive_file_t *file = &archive_files[fd];
+    uint32_t left = file->entry->size - file->pos;
+
+    size = (size < left) ? size : left;
+    memcpy(dst, archive_base + file->entry->offset + file->pos, size);
+    file->pos += size;
+    return size;
+}
+
+static off_t archive_vfs_lseek(int fd, off_t offset, int whence)
+{
+    archive_file_t *file = &archive_files[fd];
+    off_t pos;
+
+    switch (whence) {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = file->pos + offset;
+        break;
+    case SEEK_END:
+        pos = file->entry->size + offset;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((pos < 0) || (pos > file->entry->size)) {
+        errno = EINVAL;
+        return -1;
+    }
+    file->pos = pos;
+    return pos;
+}
+
+static int archive_vfs_fstat(int fd, struct stat *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->st_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+    st->st_size = archive_files[fd].entry->size;
+    return 0;
+}
+
+static int archive_vfs_close(int fd)
+{
+    archive_files[fd].entry = NULL;
+    return 0;
+}
+
+static esp_err_t archive_vfs_register(void)
+{
+    const esp_vfs_t vfs = {
+        .flags = ESP_VFS_FLAG_DEFAULT,
+        .open = archive_vfs_open,
+        .read = archive_vfs_read,
+        .lseek = archive_vfs_lseek,
+        .fstat = archive_vfs_fstat,
+        .close = archive_vfs_close,
+    };
+
+    return esp_vfs_register(PROMPT_ARCHIVE_BASE_PATH, &vfs, NULL);
+}
+
+esp_err_t prompt_archive_init(void)
+{
+    esp_err_t ret = ESP_OK;
+    const void *base;
+    int64_t start = esp_timer_get_time();
+
+    if (archive_base) {
+        return ESP_OK;
+    }
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, PROMPT_ARCHIVE_PART_SUBTYPE,
+                                  PROMPT_ARCHIVE_PART_NAME);
+    ESP_RETURN_ON_FALSE(part, ESP_ERR_NOT_FOUND, TAG, "no %s partition", PROMPT_ARCHIVE_PART_NAME);
+
+    ESP_RETURN_ON_ERROR(esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &base, &archive_mmap),
+                        TAG, "mmap failed");
+
+    const prompt_archive_header_t *header = base;
+    ESP_GOTO_ON_FALSE(0 == memcmp(header->magic, PROMPT_ARCHIVE_MAGIC, sizeof(header->magic)) &&
+                      (PROMPT_ARCHIVE_VERSION == header->version), ESP_ERR_INVALID_VERSION, err, TAG,
+                      "no prompt image in %s, flash it with idf.py flash", PROMPT_ARCHIVE_PART_NAME);
+
+    const prompt_archive_entry_t *entries = (const prompt_archive_entry_t *)(header + 1);
+    size_t index_len = header->count * sizeof(*entries) + header->hash_slots * sizeof(uint16_t);
+    ESP_GOTO_ON_FALSE((sizeof(*header) + index_len <= part->size) && header->hash_slots &&
+                      (0 == (header->hash_slots & (header->hash_slots - 1))), ESP_ERR_INVALID_SIZE, err,
+                      TAG, "index out of bounds");
+    ESP_GOTO_ON_FALSE(esp_rom_crc32_le(0, (const uint8_t *)entries, index_len) == header->index_crc,
+                      ESP_ERR_INVALID_CRC, err, TAG, "index CRC mismatch");
+    for (int i = 0; i < header->count; i++) {
+        ESP_GOTO_ON_FALSE(entries[i].offset + entries[i].size <= part->size, ESP_ERR_INVALID_SIZE, err, TAG,
+                          "entry %d out of bounds", i);
+    }
+
+    archive_base = base;
+    archive_header = header;
+    archive_entries = entries;
+    archive_slots = (const uint16_t *)&entries[header->count];
+
+#if PROMPT_ARCHIVE_VERIFY_ON_MOUNT
+    for (int i = 0; i < header->count; i++) {
+        ESP_GOTO_ON_ERROR(prompt_archive_verify(&entries[i]), err_unset, TAG, "%s is corrupted", entries[i].name);
+    }
+#endif
+
+    ESP_GOTO_ON_ERROR(archive_vfs_register(), err_unset, TAG, "VFS register failed");
+    ESP_LOGI(TAG, "%d prompts mapped at %p, mounted in %lld us", header->count, base,
+             esp_timer_get_time() - start);
+    return ESP_OK;
+
+err_unset:
+    archive_base = NULL;
+    archive_header = NULL;
+    archive_entries = NULL;
+    archive_slots = NULL;
+err:
+    esp_partition_munmap(archive_mmap);
+    return ret;
+}
+
+uint16_t prompt_archive_count(void)
+{
+    return archive_header ? archive_header->count : 0;
+}
+
+const prompt_archive_entry_t *prompt_archive_get(uint16_t index)
+{
+    return (index < prompt_archive_count()) ? &archive_entries[index] : NULL;
+}
+
+const prompt_archive_entry_t *prompt_archive_find(const char *name)
+{
+    if (NULL == archive_header) {
+        return NULL;
+    }
+
+    uint32_t slot = archive_hash(archive_header->hash_seed, name) & (archive_header->hash_slots - 1);
+    uint16_t index = archive_slots[slot];
+    if ((index < archive_header->count) &&
+            (0 == strncmp(name, archive_entries[index].name, PROMPT_ARCHIVE_NAME_LEN))) {
+        return &archive_entries[index];
+    }
+    return NULL;
+}
+
+const void *prompt_archive_data(const prompt_archive_entry_t *entry)
+{
+    return archive_base + entry->offset;
+}
+
+esp_err_t prompt_archive_verify(const prompt_archive_entry_t *entry)
+{
+    uint32_t crc = esp_rom_crc32_le(0, prompt_archive_data(entry), entry->size);
+    return (crc == entry->crc) ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+FILE *prompt_archive_fopen(const prompt_archive_entry_t *entry)
+{
+    return fmemopen((void *)prompt_archive_data(entry), entry->size, "rb");
+}
@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Layout written by tools/pack_prompts.py, keep both in sync */
+#define PROMPT_ARCHIVE_MAGIC        "PRMT"
+#define PROMPT_ARCHIVE_VERSION      2
+#define PROMPT_ARCHIVE_NAME_LEN     24
+#define PROMPT_ARCHIVE_SLOT_EMPTY   0xFFFF
+
+/* Raw data partition holding the image, see partitions.csv */
+#define PROMPT_ARCHIVE_PART_NAME    "prompts"
+#define PROMPT_ARCHIVE_PART_SUBTYPE 0x40
+
+/* The prompts can also be opened with fopen(PROMPT_ARCHIVE_BASE_PATH "/<name>", "rb") */
+#define PROMPT_ARCHIVE_BASE_PATH    "/prompts"
+#define PROMPT_ARCHIVE_MAX_FILES    4
+
+/* Set to 1 to check the CRC of every payload when mounting, the index is always checked */
+#ifndef PROMPT_ARCHIVE_VERIFY_ON_MOUNT
+#define PROMPT_ARCHIVE_VERIFY_ON_MOUNT  0
+#endif
+
+typedef enum {
+    PROMPT_FORMAT_MP3 = 0,
+    PROMPT_FORMAT_PCM16 = 1,        /*!< 16 bit mono PCM, little endian */
+    PROMPT_FORMAT_ADPCM = 2,        /*!< Mono IMA-ADPCM blocks, see app_adpcm.h */
+} prompt_format_t;
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t count;
+    uint32_t hash_seed;
+    uint16_t hash_slots;            /*!< Power of 2, follows the entries */
+    uint16_t align;                 /*!< Payload alignment */
+    uint32_t index_crc;             /*!< CRC32 of the entries and the hash table */
+} prompt_archive_header_t;
+
+typedef struct {
+    char name[PROMPT_ARCHIVE_NAME_LEN];
+    uint32_t offset;                /*!< From the start of the partition, aligned to the header's align */
+    uint32_t size;
+    uint32_t sample_rate;           /*!< PCM entries only */
+    uint32_t crc;                   /*!< CRC32 of the payload */
+    uint8_t format;                 /*!< prompt_format_t */
+    uint8_t reserved[3];
+} prompt_archive_entry_t;
+
+/**
+ * @brief Map the prompts partition, check its index and register it in the VFS
+ *
+ * @return
+ *      - ESP_OK: on success
+ *      - ESP_ERR_NOT_FOUND: no prompts partition
+ *      - ESP_ERR_INVALID_VERSION: the image is missing or was packed with another layout
+ */
+esp_err_t prompt_archive_init(void);
+
+/**
+ * @brief Number of entries, 0 if the archive is not mapped
+ */
+uint16_t prompt_archive_count(void);
+
+/**
+ * @brief Entry by index, NULL if out of range
+ */
+const prompt_archive_entry_t *prompt_archive_get(uint16_t index);
+
+/**
+ * @brief Entry by file name through the perfect hash, NULL if not found
+ */
+const prompt_archive_entry_t *prompt_archive_find(const char *name);
+
+/**
+ * @brief Payload of an entry, directly in the mapped flash
+ */
+const void *prompt_archive_data(const prompt_archive_entry_t *entry);
+
+/**
+ * @brief Check the payload of an entry against its CRC
+ *
+ * @return
+ *      - ESP_OK: the payload is intact
+ *      - ESP_ERR_INVALID_CRC: the payload is corrupted
+ */
+esp_err_t prompt_archive_verify(const prompt_archive_entry_t *entry);
+
+/**
+ * @brief Open the payload of an entry as a read only stream, e.g. for the MP3 player
+ *
+ * @note The stream reads from the mapped flash without going through the VFS, close it with fclose().
+ */
+FILE *prompt_archive_fopen(const prompt_archive_entry_t *entry);
+
+#ifdef __cplusplus
+}
+#endif
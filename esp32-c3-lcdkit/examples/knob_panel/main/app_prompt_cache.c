@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mp3dec.h"
+
+#include "app_prompt_archive.h"
+#include "app_prompt_cache.h"
+
+static const char *TAG = "prompt_cache";
+
+/* Short prompts played on every knob action, most frequent first */
+static const char *cache_candidates[] = {
+    "knob_1ch.mp3",
+    "factory.mp3",
+    "wash_end_en_1ch.mp3",
+    "wash_end_zh_1ch.mp3",
+    "snore_cute_1ch.mp3",
+};
+
+#define CACHE_CANDIDATE_NUM     (sizeof(cache_candidates) / sizeof(cache_candidates[0]))
+
+/* Decoded candidates plus PCM entries played straight from the archive */
+#define CACHE_PROMPT_MAX        16
+
+static prompt_pcm_t cache_prompts[CACHE_PROMPT_MAX];
+static const void *cache_data[CACHE_PROMPT_MAX];         /* Archive payload a prompt was decoded from */
+static uint8_t cache_num;
+static size_t cache_used;
+
+/* Decode into the remaining budget, stereo is mixed down to mono */
+static esp_err_t prompt_decode(HMP3Decoder decoder, prompt_pcm_t *prompt, const uint8_t *mp3, size_t mp3_len,
+                               int16_t *frame_pcm)
+{
+    size_t budget = PROMPT_CACHE_BUDGET - cache_used;
+    int16_t *pcm = heap_caps_malloc(budget, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    ESP_RETURN_ON_FALSE(pcm, ESP_ERR_NO_MEM, TAG, "no mem for %s", prompt->name);
+
+    unsigned char *in = (unsigned char *)mp3;
+    int left = mp3_len;
+    size_t len = 0;
+    MP3FrameInfo info = {0};
+
+    while (left > 0) {
+        int offset = MP3FindSyncWord(in, left);
+        if (offset < 0) {
+            break;
+        }
+        in += offset;
+        left -= offset;
+
+        int err = MP3Decode(decoder, &in, &left, frame_pcm, 0);
+        if (ERR_MP3_MAINDATA_UNDERFLOW == err) {
+            continue;
+        } else if (ERR_MP3_NONE != err) {
+            break;
+        }
+
+        MP3GetLastFrameInfo(decoder, &info);
+        size_t samples = info.outputSamps / info.nChans;
+        if (len + samples * sizeof(int16_t) > budget) {
+            heap_caps_free(pcm);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        for (int i = 0; i < samples; i++) {
+            pcm[len / sizeof(int16_t) + i] = (2 == info.nChans) ?
+                                             ((frame_pcm[2 * i] + frame_pcm[2 * i + 1]) / 2) : frame_pcm[i];
+        }
+        len += samples * sizeof(int16_t);
+    }
+    if (0 == len) {
+        heap_caps_free(pcm);
+        ESP_LOGW(TAG, "%s decoded to nothing", prompt->name);
+        return ESP_FAIL;
+    }
+
+    prompt->pcm = heap_caps_realloc(pcm, len, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    if (NULL == prompt->pcm) {
+        prompt->pcm = pcm;
+    }
+    prompt->len = len;
+    prompt->sample_rate = info.samprate;
+    cache_used += len;
+    return ESP_OK;
+}
+
+static const prompt_pcm_t *prompt_cache_find_data(const void *data)
+{
+    for (int i = 0; i < cache_num; i++) {
+        if (cache_data[i] == data) {
+            return &cache_prompts[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t prompt_cache_init(void)
+{
+    int64_t start = esp_timer_get_time();
+
+    /* PCM in the archive is played in place, it costs no RAM */
+    for (int i = 0; (i < prompt_archive_count()) && (cache_num < CACHE_PROMPT_MAX); i++) {
+        const prompt_archive_entry_t *entry = prompt_archive_get(i);
+        if (PROMPT_FORMAT_PCM16 == entry->format) {
+            cache_data[cache_num] = prompt_archive_data(entry);
+            prompt_pcm_t *prompt = &cache_prompts[cache_num++];
+            prompt->name = entry->name;
+            prompt->sample_rate = entry->sample_rate;
+            prompt->len = entry->size;
+            prompt->pcm = (int16_t *)prompt_archive_data(entry);
+        }
+    }
+
+    HMP3Decoder decoder = MP3InitDecoder();
+    ESP_RETURN_ON_FALSE(decoder, ESP_ERR_NO_MEM, TAG, "no mem for mp3 decoder");
+    int16_t *frame_pcm = malloc(MAX_NCHAN * MAX_NGRAN * MAX_NSAMP * sizeof(int16_t));
+    if (NULL == frame_pcm) {
+        MP3FreeDecoder(decoder);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; (i < CACHE_CANDIDATE_NUM) && (cache_num < CACHE_PROMPT_MAX); i++) {
+        const prompt_archive_entry_t *entry = prompt_archive_find(cache_candidates[i]);
+        if ((NULL == entry) || (PROMPT_FORMAT_MP3 != entry->format)) {
+            continue;
+        }
+
+        prompt_pcm_t *prompt = &cache_prompts[cache_num];
+        prompt->name = entry->name;
+
+        /* Aliases of a decoded payload share its PCM */
+        const prompt_pcm_t *same = prompt_cache_find_data(prompt_archive_data(entry));
+        if (same) {
+            prompt->sample_rate = same->sample_rate;
+            prompt->len = same->len;
+            prompt->pcm = same->pcm;
+            cache_data[cache_num++] = prompt_archive_data(entry);
+            ESP_LOGI(TAG, "%s: shares the PCM of %s", prompt->name, same->name);
+            continue;
+        }
+
+        esp_err_t ret = prompt_decode(decoder, prompt, prompt_archive_data(entry), entry->size, frame_pcm);
+        if (ESP_OK != ret) {
+            ESP_LOGW(TAG, "%s not cached (%s)", prompt->name, esp_err_to_name(ret));
+            memset(prompt, 0, sizeof(prompt_pcm_t));
+            continue;
+        }
+        cache_data[cache_num++] = prompt_archive_data(entry);
+        ESP_LOGI(TAG, "%s: %d bytes PCM at %d Hz", prompt->name, prompt->len, prompt->sample_rate);
+    }
+
+    free(frame_pcm);
+    MP3FreeDecoder(decoder);
+    ESP_LOGI(TAG, "%d prompts, %d of %d bytes RAM used, decoded in %lld ms", cache_num, cache_used,
+             PROMPT_CACHE_BUDGET, (esp_timer_get_time() - start) / 1000);
+    return ESP_OK;
+}
+
+const prompt_pcm_t *prompt_cache_get(const char *name)
+{
+    for (int i = 0; i < cache_num; i++) {
+        if (0 == strncmp(name, cache_prompts[i].name, PROMPT_ARCHIVE_NAME_LEN)) {
+            return &cache_prompts[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,56 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* RAM spent on decoded prompts, prompts which do not fit any more are played from MP3 */
+#ifndef PROMPT_CACHE_BUDGET
+#define PROMPT_CACHE_BUDGET     (32 * 1024)
+#endif
+
+/**
+ * @brief Prompt decoded to 16 bit mono PCM
+ */
+typedef struct {
+    const char *name;           /*!< Name in the prompt archive */
+    uint32_t sample_rate;
+    size_t len;                 /*!< PCM length in bytes */
+    int16_t *pcm;               /*!< In RAM, or in the mapped archive for PCM entries */
+} prompt_pcm_t;
+
+/**
+ * @brief Decode the short MP3 prompts into RAM, in order of the candidate list
+ *
+ * PCM entries of the archive are added without copying them.
+ *
+ * @note The prompt archive must be mapped.
+ *
+ * @return
+ *      - ESP_OK: at least nothing failed unexpectedly, prompts over budget are skipped
+ *      - ESP_ERR_NO_MEM: the MP3 decoder could not be allocated
+ */
+esp_err_t prompt_cache_init(void);
+
+/**
+ * @brief Look up a decoded prompt
+ *
+ * @param name Name in the prompt archive
+ *
+ * @return Decoded prompt, NULL if it is not cached
+ */
+const prompt_pcm_t *prompt_cache_get(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
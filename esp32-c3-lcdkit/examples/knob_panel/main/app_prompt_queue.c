@@ -0,0 +1,310 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_prompt_queue.h"
+
+static const char *TAG = "prompt_queue";
+
+typedef struct {
+    PDM_SOUND_TYPE sound;
+    prompt_prio_t prio;
+    prompt_key_t key;
+    uint32_t seq;
+    int64_t post_us;
+} prompt_req_t;
+
+static prompt_req_t pending[PROMPT_QUEUE_LEN];
+static uint8_t pending_num;
+static uint32_t pending_seq;
+
+static SemaphoreHandle_t queue_mutex;
+static TaskHandle_t queue_task;
+
+static bool playing;
+static prompt_prio_t playing_prio;
+static prompt_key_t playing_key;
+
+static prompt_queue_stats_t queue_stats;
+static uint64_t latency_us_sum;
+
+static void queue_remove(int index)
+{
+    memmove(&pending[index], &pending[index + 1], (pending_num - index - 1) * sizeof(prompt_req_t));
+    pending_num--;
+}
+
+/* Highest priority first, oldest first within a priority */
+static int queue_pick(void)
+{
+    int best = -1;
+
+    for (int i = 0; i < pending_num; i++) {
+        if ((best < 0) || (pending[i].prio > pending[best].prio) ||
+                ((pending[i].prio == pending[best].prio) && (pending[i].seq < pending[best].seq))) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void queue_idle_cb(void)
+{
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    playing = false;
+    xSemaphoreGive(queue_mutex);
+    xTaskNotifyGive(queue_task);
+}
+
+/* Take the next prompt to play, if it may start now. Called with queue_mutex held */
+static bool queue_next(prompt_req_t *req, bool *preempt)
+{
+    int index = queue_pick();
+    if (index < 0) {
+        return false;
+    }
+
+    *req = pending[index];
+    *preempt = playing && ((req->prio > playing_prio) ||
+                           ((PROMPT_KEY_NONE != req->key) && (req->key == playing_key)));
+    if (playing && !*preempt) {
+        return false;
+    }
+    queue_remove(index);
+
+    uint32_t latency_us = esp_timer_get_time() - req->post_us;
+    queue_stats.played++;
+    queue_stats.preempted += *preempt;
+    queue_stats.latency_us_max = MAX(queue_stats.latency_us_max, latency_us);
+    latency_us_sum += latency_us;
+    queue_stats.latency_us_avg = latency_us_sum / queue_stats.played;
+
+    playing = true;
+    playing_prio = req->prio;
+    playing_key = req->key;
+    return true;
+}
+
+/* Queue or coalesce a prompt. Called with queue_mutex held */
+static esp_err_t queue_push(PDM_SOUND_TYPE sound, prompt_prio_t prio, prompt_key_t key)
+{
+    queue_stats.posted++;
+
+    int index = -1;
+    if (PROMPT_KEY_NONE != key) {
+        for (int i = 0; i < pending_num; i++) {
+            if (key == pending[i].key) {
+                index = i;
+                queue_stats.coalesced++;
+                prio = MAX(prio, pending[i].prio);
+                break;
+            }
+        }
+    }
+
+    if ((index < 0) && (PROMPT_QUEUE_LEN == pending_num)) {
+        /* Make room by dropping the lowest priority, oldest first */
+        int victim = 0;
+        for (int i = 1; i < pending_num; i++) {
+            if ((pending[i].prio < pending[victim].prio) ||
+                    ((pending[i].prio == pending[victim].prio) && (pending[i].seq < pending[victim].seq))) {
+                victim = i;
+            }
+        }
+        queue_stats.dropped++;
+        if (pending[victim].prio > prio) {
+            ESP_LOGW(TAG, "queue full, drop %d", sound);
+            return ESP_ERR_NO_MEM;
+        }
+        ESP_LOGW(TAG, "queue full, drop %d", pending[victim].sound);
+        queue_remove(victim);
+    }
+
+    if (index < 0) {
+        index = pending_num++;
+    }
+    pending[index].sound = sound;
+    pending[index].prio = prio;
+    pending[index].key = key;
+    pending[index].seq = pending_seq++;
+    pending[index].post_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static void prompt_queue_task(void *arg)
+{
+    prompt_req_t req;
+    bool preempt;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(queue_mutex, portMAX_DELAY);
+        bool play = queue_next(&req, &preempt);
+        xSemaphoreGive(queue_mutex);
+        if (!play) {
+            continue;
+        }
+
+        ESP_LOGD(TAG, "play %d, prio %d%s", req.sound, req.prio, preempt ? ", preempt" : "");
+        if (ESP_OK != audio_handle_info(req.sound)) {
+            queue_idle_cb();
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t prompt_queue_post(PDM_SOUND_TYPE sound, prompt_prio_t prio, prompt_key_t key)
+{
+    ESP_RETURN_ON_FALSE(queue_task, ESP_ERR_INVALID_STATE, TAG, "not started");
+
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    esp_err_t ret = queue_push(sound, prio, key);
+    xSemaphoreGive(queue_mutex);
+
+    if (ESP_OK == ret) {
+        xTaskNotifyGive(queue_task);
+    }
+    return ret;
+}
+
+void prompt_queue_get_stats(prompt_queue_stats_t *stats)
+{
+    if (NULL == queue_mutex) {
+        memset(stats, 0, sizeof(prompt_queue_stats_t));
+        return;
+    }
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    memcpy(stats, &queue_stats, sizeof(prompt_queue_stats_t));
+    xSemaphoreGive(queue_mutex);
+}
+
+#if PROMPT_QUEUE_SELFTEST
+/* Pop the next prompt as the task would, -1 if none may start. The prompt keeps playing if keep_playing */
+static int selftest_pop(bool keep_playing)
+{
+    prompt_req_t req;
+    bool preempt;
+
+    if (!queue_next(&req, &preempt)) {
+        return -1;
+    }
+    playing = keep_playing;
+    return req.sound;
+}
+
+/* Runs on the queue itself before the task is started, nothing is played */
+static void prompt_queue_selftest(void)
+{
+    uint32_t fail = 0;
+
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+
+    /* Order: highest priority first, in posting order within a priority */
+    queue_push(SOUND_TYPE_KNOB, PROMPT_PRIO_NORMAL, PROMPT_KEY_NONE);
+    queue_push(SOUND_TYPE_SNORE, PROMPT_PRIO_LOW, PROMPT_KEY_NONE);
+    queue_push(SOUND_TYPE_FACTORY, PROMPT_PRIO_NORMAL, PROMPT_KEY_NONE);
+    queue_push(SOUND_TYPE_ALARM, PROMPT_PRIO_HIGH, PROMPT_KEY_NONE);
+    const int order[] = {SOUND_TYPE_ALARM, SOUND_TYPE_KNOB, SOUND_TYPE_FACTORY, SOUND_TYPE_SNORE, -1};
+    for (int i = 0; i < (int)(sizeof(order) / sizeof(order[0])); i++) {
+        int sound = selftest_pop(false);
+        if (sound != order[i]) {
+            ESP_LOGE(TAG, "selftest: pop %d is %d, expected %d", i, sound, order[i]);
+            fail++;
+        }
+    }
+
+    /* Coalescing: a pending brightness prompt is replaced by the newer one */
+    queue_push(SOUND_TYPE_LIGHT_25, PROMPT_PRIO_NORMAL, PROMPT_KEY_LIGHT_LEVEL);
+    queue_push(SOUND_TYPE_LIGHT_50, PROMPT_PRIO_NORMAL, PROMPT_KEY_LIGHT_LEVEL);
+    queue_push(SOUND_TYPE_LIGHT_75, PROMPT_PRIO_NORMAL, PROMPT_KEY_LIGHT_LEVEL);
+    if ((1 != pending_num) || (SOUND_TYPE_LIGHT_75 != selftest_pop(false))) {
+        ESP_LOGE(TAG, "selftest: brightness prompts not coalesced, %d pending", pending_num);
+        fail++;
+    }
+
+    /* Preemption: a NORMAL prompt waits for the playing one, a HIGH one cuts it off */
+    queue_push(SOUND_TYPE_LIGHT_ON, PROMPT_PRIO_NORMAL, PROMPT_KEY_NONE);
+    selftest_pop(true);
+    queue_push(SOUND_TYPE_COLOR_WARM, PROMPT_PRIO_NORMAL, PROMPT_KEY_NONE);
+    if (-1 != selftest_pop(true)) {
+        ESP_LOGE(TAG, "selftest: NORMAL prompt cut off a NORMAL one");
+        fail++;
+    }
+    queue_push(SOUND_TYPE_ALARM, PROMPT_PRIO_HIGH, PROMPT_KEY_NONE);
+    if (SOUND_TYPE_ALARM != selftest_pop(true)) {
+        ESP_LOGE(TAG, "selftest: HIGH prompt did not preempt");
+        fail++;
+    }
+    playing = false;
+    selftest_pop(false);
+
+    /* Full queue: the lowest priority is dropped, a lower newcomer is refused */
+    for (int i = 0; i < PROMPT_QUEUE_LEN; i++) {
+        queue_push(SOUND_TYPE_KNOB, PROMPT_PRIO_LOW, PROMPT_KEY_NONE);
+    }
+    if (ESP_OK != queue_push(SOUND_TYPE_ALARM, PROMPT_PRIO_HIGH, PROMPT_KEY_NONE)) {
+        ESP_LOGE(TAG, "selftest: HIGH prompt refused by a LOW queue");
+        fail++;
+    }
+    for (int i = 1; i < PROMPT_QUEUE_LEN; i++) {
+        queue_push(SOUND_TYPE_ALARM, PROMPT_PRIO_HIGH, PROMPT_KEY_NONE);
+    }
+    if (ESP_ERR_NO_MEM != queue_push(SOUND_TYPE_KNOB, PROMPT_PRIO_LOW, PROMPT_KEY_NONE)) {
+        ESP_LOGE(TAG, "selftest: LOW prompt accepted by a HIGH queue");
+        fail++;
+    }
+
+    /* 4 + 3 + 3 + 8 + 1 + 7 + 1 posted */
+    const prompt_queue_stats_t expected = {
+        .posted = 27, .played = 8, .coalesced = 2, .dropped = PROMPT_QUEUE_LEN + 1, .preempted = 1,
+    };
+    if ((queue_stats.posted != expected.posted) || (queue_stats.played != expected.played) ||
+            (queue_stats.coalesced != expected.coalesced) || (queue_stats.dropped != expected.dropped) ||
+            (queue_stats.preempted != expected.preempted)) {
+        ESP_LOGE(TAG, "selftest: stats posted %u played %u coalesced %u dropped %u preempted %u",
+                 queue_stats.posted, queue_stats.played, queue_stats.coalesced, queue_stats.dropped,
+                 queue_stats.preempted);
+        fail++;
+    }
+
+    pending_num = 0;
+    pending_seq = 0;
+    playing = false;
+    latency_us_sum = 0;
+    memset(&queue_stats, 0, sizeof(queue_stats));
+    xSemaphoreGive(queue_mutex);
+
+    ESP_LOGI(TAG, "selftest: %s", fail ? "FAIL" : "ok");
+}
+#endif
+
+esp_err_t prompt_queue_init(void)
+{
+    if (queue_task) {
+        return ESP_OK;
+    }
+
+    queue_mutex = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(queue_mutex, ESP_ERR_NO_MEM, TAG, "no mem for mutex");
+
+#if PROMPT_QUEUE_SELFTEST
+    prompt_queue_selftest();
+#endif
+
+    audio_register_idle_cb(queue_idle_cb);
+    BaseType_t ret_val = xTaskCreate(prompt_queue_task, "prompt_queue", 3 * 1024, NULL, 5, &queue_task);
+    ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "create task failed");
+    return ESP_OK;
+}
@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "app_audio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROMPT_QUEUE_LEN    8
+
+/* Set to 1 to check ordering, coalescing, preemption and the stats of the queue at init */
+#ifndef PROMPT_QUEUE_SELFTEST
+#define PROMPT_QUEUE_SELFTEST   0
+#endif
+
+typedef enum {
+    PROMPT_PRIO_LOW,
+    PROMPT_PRIO_NORMAL,
+    PROMPT_PRIO_HIGH,               /*!< Alarms, preempt any lower prompt */
+} prompt_prio_t;
+
+/* A pending prompt is replaced by a newer one with the same key */
+typedef enum {
+    PROMPT_KEY_NONE,                /*!< Never coalesced */
+    PROMPT_KEY_LIGHT_LEVEL,
+    PROMPT_KEY_LIGHT_COLOR,
+    PROMPT_KEY_FACTORY_SOUND,
+} prompt_key_t;
+
+typedef struct {
+    uint32_t posted;
+    uint32_t played;
+    uint32_t coalesced;             /*!< Replaced by a newer prompt with the same key */
+    uint32_t dropped;               /*!< Queue full, lowest priority dropped */
+    uint32_t preempted;             /*!< Cut off by a higher priority or newer same-key prompt */
+    uint32_t latency_us_max;        /*!< Post to start of playback */
+    uint32_t latency_us_avg;
+} prompt_queue_stats_t;
+
+/**
+ * @brief Start the prompt service, called by audio_play_start()
+ *
+ * The service task and the PROMPT_QUEUE_LEN slots live for the whole run, posting allocates nothing.
+ */
+esp_err_t prompt_queue_init(void);
+
+/**
+ * @brief Queue a prompt
+ *
+ * @param sound Prompt to play
+ * @param prio Priority, higher priorities play first and preempt the playing prompt
+ * @param key Coalescing key, a pending prompt with the same key is replaced
+ *
+ * @return
+ *      - ESP_OK: queued or coalesced
+ *      - ESP_ERR_NO_MEM: queue full of higher priority prompts, dropped
+ *      - ESP_ERR_INVALID_STATE: service not started
+ */
+esp_err_t prompt_queue_post(PDM_SOUND_TYPE sound, prompt_prio_t prio, prompt_key_t key);
+
+void prompt_queue_get_stats(prompt_queue_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
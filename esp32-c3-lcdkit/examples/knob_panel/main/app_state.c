@@ -0,0 +1,496 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "app_light_model.h"
+#include "app_state.h"
+#include "app_write_behind.h"
+
+static const char *TAG = "app_state";
+
+/*
+ * The journal lives in one of two sectors: a header, then 4 byte change records appended
+ * in order up to the first erased word. When the sector is full, the whole state is written
+ * as records to the other, erased sector, and its header is written last, so a power cut
+ * during the compaction leaves the old sector in charge.
+ */
+#define SECTOR_NUM          2
+#define RECORD_ERASED       0xFFFFFFFF
+#define REPLAY_CHUNK        16
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;                   /*!< The sector with the highest seq holds the journal */
+    uint32_t seq_inv;               /*!< ~seq, a header torn by a power cut does not match */
+} journal_head_t;
+
+typedef struct {
+    uint8_t field;                  /*!< app_state_field_t */
+    uint8_t value[2];               /*!< Little endian */
+    uint8_t crc;                    /*!< CRC8 of the bytes before, a torn record does not match */
+} journal_record_t;
+
+_Static_assert(sizeof(journal_record_t) == sizeof(uint32_t), "records are read as words");
+
+/* Flash below the journal: the partition, or the RAM stand-in of the selftest */
+typedef struct {
+    esp_err_t (*read)(void *ctx, size_t offset, void *buf, size_t len);
+    esp_err_t (*write)(void *ctx, size_t offset, const void *buf, size_t len);
+    esp_err_t (*erase)(void *ctx, size_t offset, size_t len);
+    void *ctx;
+    size_t sector_size;
+} journal_flash_t;
+
+typedef struct {
+    const journal_flash_t *flash;
+    uint8_t sector;                 /*!< Holding the journal */
+    uint32_t seq;
+    size_t write_offset;            /*!< Next record in the sector */
+    uint32_t compactions;
+} journal_t;
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t def;
+} app_state_range_t;
+
+static const app_state_range_t state_range[APP_STATE_FIELD_MAX] = {
+    [APP_STATE_LIGHT_LEVEL]     = {0, LIGHT_LEVEL_MAX, 50},
+    [APP_STATE_THERMOSTAT_TEMP] = {19, 30, 22},     /* Range of the thermostat roller */
+    [APP_STATE_WASH_PROGRAM]    = {0, 2, 0},        /* wash_cycle[] in ui_washing.c */
+    [APP_STATE_LIGHT_TIMER_S]   = {0, 60 * 60, 0},
+};
+
+static int32_t state_values[APP_STATE_FIELD_MAX];
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Values in the journal, the commit appends the fields which differ */
+static int32_t written_values[APP_STATE_FIELD_MAX];
+static journal_t journal;
+static journal_flash_t part_flash;
+
+static esp_err_t app_state_commit(void);
+
+static write_behind_client_t state_client = {
+    .name = "app_state",
+    .delay_ms = APP_STATE_WRITE_DELAY_MS,
+    .commit = app_state_commit,
+};
+static app_state_stats_t state_stats;
+
+static void app_state_set_default(int32_t *values)
+{
+    for (int i = 0; i < APP_STATE_FIELD_MAX; i++) {
+        values[i] = state_range[i].def;
+    }
+}
+
+static void journal_record_make(journal_record_t *rec, uint8_t field, int32_t value)
+{
+    rec->field = field;
+    rec->value[0] = value & 0xFF;
+    rec->value[1] = (value >> 8) & 0xFF;
+    rec->crc = esp_rom_crc8_le(0, (const uint8_t *)rec, offsetof(journal_record_t, crc));
+}
+
+static bool journal_record_apply(const journal_record_t *rec, int32_t *values)
+{
+    if ((rec->field >= APP_STATE_FIELD_MAX) ||
+            (rec->crc != esp_rom_crc8_le(0, (const uint8_t *)rec, offsetof(journal_record_t, crc)))) {
+        return false;
+    }
+
+    int32_t value = rec->value[0] | (rec->value[1] << 8);
+    if ((value < state_range[rec->field].min) || (value > state_range[rec->field].max)) {
+        return false;
+    }
+    values[rec->field] = value;
+    return true;
+}
+
+static bool journal_head_read(journal_t *j, uint8_t sector, uint32_t *seq)
+{
+    journal_head_t head;
+
+    if (ESP_OK != j->flash->read(j->flash->ctx, sector * j->flash->sector_size, &head, sizeof(journal_head_t))) {
+        return false;
+    }
+    if ((APP_STATE_MAGIC != head.magic) || (head.seq != ~head.seq_inv)) {
+        return false;
+    }
+    *seq = head.seq;
+    return true;
+}
+
+/* Applies the records of the sector in order, records torn by a power cut are skipped */
+static esp_err_t journal_replay(journal_t *j, int32_t *values)
+{
+    const size_t base = j->sector * j->flash->sector_size;
+    journal_record_t rec[REPLAY_CHUNK];
+    size_t offset = sizeof(journal_head_t);
+
+    while (offset < j->flash->sector_size) {
+        size_t num = MIN(REPLAY_CHUNK, (j->flash->sector_size - offset) / sizeof(journal_record_t));
+        ESP_RETURN_ON_ERROR(j->flash->read(j->flash->ctx, base + offset, rec, num * sizeof(journal_record_t)),
+                            TAG, "read failed");
+        for (int i = 0; i < num; i++, offset += sizeof(journal_record_t)) {
+            uint32_t word;
+            memcpy(&word, &rec[i], sizeof(uint32_t));
+            if (RECORD_ERASED == word) {
+                j->write_offset = offset;
+                return ESP_OK;
+            }
+            journal_record_apply(&rec[i], values);
+        }
+    }
+    j->write_offset = j->flash->sector_size;
+    return ESP_OK;
+}
+
+/* Writes the values to the other sector, which takes over once its header is written */
+static esp_err_t journal_compact(journal_t *j, const int32_t *values)
+{
+    const uint8_t sector = (j->sector + 1) % SECTOR_NUM;
+    const size_t base = sector * j->flash->sector_size;
+    const journal_head_t head = {
+        .magic = APP_STATE_MAGIC,
+        .seq = j->seq + 1,
+        .seq_inv = ~(j->seq + 1),
+    };
+    journal_record_t rec[APP_STATE_FIELD_MAX];
+
+    for (int i = 0; i < APP_STATE_FIELD_MAX; i++) {
+        journal_record_make(&rec[i], i, values[i]);
+    }
+    ESP_RETURN_ON_ERROR(j->flash->erase(j->flash->ctx, base, j->flash->sector_size), TAG, "erase failed");
+    ESP_RETURN_ON_ERROR(j->flash->write(j->flash->ctx, base + sizeof(journal_head_t), rec, sizeof(rec)),
+                        TAG, "snapshot write failed");
+    ESP_RETURN_ON_ERROR(j->flash->write(j->flash->ctx, base, &head, sizeof(journal_head_t)),
+                        TAG, "head write failed");
+
+    j->sector = sector;
+    j->seq = head.seq;
+    j->write_offset = sizeof(journal_head_t) + sizeof(rec);
+    j->compactions++;
+    return ESP_OK;
+}
+
+static esp_err_t journal_format(journal_t *j, const int32_t *values)
+{
+    j->sector = SECTOR_NUM - 1;
+    j->seq = 0;
+    return journal_compact(j, values);
+}
+
+/* Replays the newest sector into values, a flash without a valid header is formatted with them */
+static esp_err_t journal_mount(journal_t *j, int32_t *values)
+{
+    uint32_t seq[SECTOR_NUM] = {0};
+    int newest = -1;
+
+    ESP_RETURN_ON_FALSE(j->flash->sector_size >= sizeof(journal_head_t) + (APP_STATE_FIELD_MAX + 1) * sizeof(journal_record_t),
+                        ESP_ERR_INVALID_SIZE, TAG, "sector too small");
+
+    for (int i = 0; i < SECTOR_NUM; i++) {
+        if (journal_head_read(j, i, &seq[i]) && ((newest < 0) || (seq[i] > seq[newest]))) {
+            newest = i;
+        }
+    }
+    if (newest < 0) {
+        ESP_LOGW(TAG, "No journal, formatting");
+        return journal_format(j, values);
+    }
+
+    j->sector = newest;
+    j->seq = seq[newest];
+    return journal_replay(j, values);
+}
+
+/* Appends the fields of values which differ from written, or compacts if the sector is full */
+static esp_err_t journal_commit(journal_t *j, const int32_t *values, int32_t *written, uint32_t *records)
+{
+    journal_record_t rec[APP_STATE_FIELD_MAX];
+    size_t num = 0;
+    esp_err_t ret;
+
+    for (int i = 0; i < APP_STATE_FIELD_MAX; i++) {
+        if (values[i] != written[i]) {
+            journal_record_make(&rec[num++], i, values[i]);
+        }
+    }
+    if (0 == num) {
+        return ESP_OK;
+    }
+
+    if (j->write_offset + num * sizeof(journal_record_t) > j->flash->sector_size) {
+        ret = journal_compact(j, values);
+    } else {
+        ret = j->flash->write(j->flash->ctx, j->sector * j->flash->sector_size + j->write_offset,
+                              rec, num * sizeof(journal_record_t));
+        /* Also on failure, the bits programmed so far can't be written again */
+        j->write_offset += num * sizeof(journal_record_t);
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "journal write failed");
+
+    memcpy(written, values, sizeof(int32_t) * APP_STATE_FIELD_MAX);
+    if (records) {
+        *records += num;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t part_read(void *ctx, size_t offset, void *buf, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, buf, len);
+}
+
+static esp_err_t part_write(void *ctx, size_t offset, const void *buf, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, buf, len);
+}
+
+static esp_err_t part_erase(void *ctx, size_t offset, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, len);
+}
+
+/* Called by the write-behind service, which runs one commit at a time */
+static esp_err_t app_state_commit(void)
+{
+    int32_t values[APP_STATE_FIELD_MAX];
+
+    taskENTER_CRITICAL(&state_lock);
+    memcpy(values, state_values, sizeof(values));
+    taskEXIT_CRITICAL(&state_lock);
+
+    esp_err_t ret = journal_commit(&journal, values, written_values, &state_stats.records);
+    if (ESP_OK == ret) {
+        state_stats.commits++;
+    } else {
+        state_stats.failed++;
+    }
+    state_stats.compactions = journal.compactions;
+    return ret;
+}
+
+int32_t app_state_get(app_state_field_t field)
+{
+    return (field < APP_STATE_FIELD_MAX) ? state_values[field] : 0;
+}
+
+void app_state_set(app_state_field_t field, int32_t value)
+{
+    bool changed = false;
+
+    if (field >= APP_STATE_FIELD_MAX) {
+        return;
+    }
+    value = MIN(MAX(value, state_range[field].min), state_range[field].max);
+
+    taskENTER_CRITICAL(&state_lock);
+    if (state_values[field] != value) {
+        state_values[field] = value;
+        changed = true;
+    }
+    taskEXIT_CRITICAL(&state_lock);
+
+    if (changed && state_client.timer) {
+        state_stats.sets++;
+        write_behind_mark(&state_client);
+    }
+}
+
+void app_state_reset(void)
+{
+    for (int i = 0; i < APP_STATE_FIELD_MAX; i++) {
+        app_state_set(i, state_range[i].def);
+    }
+}
+
+esp_err_t app_state_flush(void)
+{
+    return write_behind_flush(&state_client);
+}
+
+void app_state_get_stats(app_state_stats_t *stats)
+{
+    memcpy(stats, &state_stats, sizeof(app_state_stats_t));
+}
+
+#if APP_STATE_SELFTEST
+#define SELFTEST_SECTOR_SIZE    128     /* Small, so the commits cross many compactions */
+#define SELFTEST_COMMITS        120
+#define SELFTEST_CUT_STEP       3       /* Bytes, cuts land on every byte of a record over the runs */
+
+static struct {
+    uint8_t mem[SECTOR_NUM * SELFTEST_SECTOR_SIZE];
+    int32_t budget;                     /* Bytes programmed or erased until the power cut, -1 for none */
+} test_flash;
+
+static esp_err_t selftest_read(void *ctx, size_t offset, void *buf, size_t len)
+{
+    memcpy(buf, &test_flash.mem[offset], len);
+    return ESP_OK;
+}
+
+static esp_err_t selftest_write(void *ctx, size_t offset, const void *buf, size_t len)
+{
+    const uint8_t *src = buf;
+
+    for (size_t i = 0; i < len; i++) {
+        if (0 == test_flash.budget) {
+            return ESP_FAIL;
+        }
+        if (test_flash.budget > 0) {
+            test_flash.budget--;
+        }
+        /* NOR flash only clears bits */
+        test_flash.mem[offset + i] &= src[i];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t selftest_erase(void *ctx, size_t offset, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (0 == test_flash.budget) {
+            return ESP_FAIL;
+        }
+        if (test_flash.budget > 0) {
+            test_flash.budget--;
+        }
+        test_flash.mem[offset + i] = 0xFF;
+    }
+    return ESP_OK;
+}
+
+static const journal_flash_t selftest_flash = {
+    .read = selftest_read,
+    .write = selftest_write,
+    .erase = selftest_erase,
+    .sector_size = SELFTEST_SECTOR_SIZE,
+};
+
+/*
+ * Commits pseudo random changes until the power is cut after cut bytes, then mounts the
+ * journal again: every field must hold its last committed value or the one being written.
+ * Returns false if a field holds another value, *cut_hit is false if all commits were written.
+ */
+static bool selftest_run(int32_t cut, bool *cut_hit)
+{
+    int32_t values[APP_STATE_FIELD_MAX], written[APP_STATE_FIELD_MAX], restored[APP_STATE_FIELD_MAX];
+    journal_t j = {.flash = &selftest_flash};
+    uint32_t rand = 1;
+
+    memset(test_flash.mem, 0xFF, sizeof(test_flash.mem));
+    test_flash.budget = -1;
+    app_state_set_default(values);
+    if (ESP_OK != journal_mount(&j, values)) {
+        return false;
+    }
+    memcpy(written, values, sizeof(values));
+
+    test_flash.budget = cut;
+    *cut_hit = false;
+    for (int n = 0; n < SELFTEST_COMMITS; n++) {
+        for (int k = 0; k <= n % 2; k++) {
+            rand = rand * 1103515245 + 12345;
+            int field = (rand >> 16) % APP_STATE_FIELD_MAX;
+            const app_state_range_t *range = &state_range[field];
+            values[field] = range->min + (rand >> 8) % (range->max - range->min + 1);
+        }
+        if (ESP_OK != journal_commit(&j, values, written, NULL)) {
+            *cut_hit = true;
+            break;
+        }
+    }
+
+    /* Power back */
+    test_flash.budget = -1;
+    j = (journal_t) {.flash = &selftest_flash};
+    app_state_set_default(restored);
+    if (ESP_OK != journal_mount(&j, restored)) {
+        return false;
+    }
+    for (int i = 0; i < APP_STATE_FIELD_MAX; i++) {
+        if ((restored[i] != written[i]) && (restored[i] != values[i])) {
+            return false;
+        }
+    }
+
+    /* The journal takes changes again after the cut */
+    memcpy(written, restored, sizeof(restored));
+    restored[APP_STATE_WASH_PROGRAM] = (restored[APP_STATE_WASH_PROGRAM] + 1) % 3;
+    if (ESP_OK != journal_commit(&j, restored, written, NULL)) {
+        return false;
+    }
+    j = (journal_t) {.flash = &selftest_flash};
+    app_state_set_default(values);
+    return (ESP_OK == journal_mount(&j, values)) && (0 == memcmp(values, restored, sizeof(values)));
+}
+
+static void app_state_selftest(void)
+{
+    uint32_t runs = 0, failed = 0;
+    bool cut_hit = true;
+
+    for (int32_t cut = 0; cut_hit; cut += SELFTEST_CUT_STEP, runs++) {
+        if (!selftest_run(cut, &cut_hit)) {
+            ESP_LOGW(TAG, "selftest: wrong state after a power cut at byte %d", cut);
+            failed++;
+        }
+    }
+    ESP_LOGI(TAG, "selftest: %u power cuts, %u wrong states: %s", runs - 1, failed, failed ? "FAIL" : "ok");
+}
+#endif
+
+esp_err_t app_state_init(void)
+{
+    if (state_client.timer) {
+        return ESP_OK;
+    }
+    app_state_set_default(state_values);
+
+#if APP_STATE_SELFTEST
+    app_state_selftest();
+#endif
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, APP_STATE_PART_SUBTYPE,
+                                  APP_STATE_PART_NAME);
+    ESP_RETURN_ON_FALSE(part, ESP_ERR_NOT_FOUND, TAG, "no %s partition", APP_STATE_PART_NAME);
+    ESP_RETURN_ON_FALSE(part->size >= SECTOR_NUM * part->erase_size, ESP_ERR_INVALID_SIZE, TAG,
+                        "%s partition too small", APP_STATE_PART_NAME);
+
+    part_flash = (journal_flash_t) {
+        .read = part_read,
+        .write = part_write,
+        .erase = part_erase,
+        .ctx = (void *)part,
+        .sector_size = part->erase_size,
+    };
+    journal.flash = &part_flash;
+
+    esp_err_t ret = journal_mount(&journal, state_values);
+    if (ESP_OK != ret) {
+        ESP_LOGW(TAG, "Journal unreadable (0x%x), formatting", ret);
+        app_state_set_default(state_values);
+        ESP_RETURN_ON_ERROR(journal_format(&journal, state_values), TAG, "format failed");
+    }
+    memcpy(written_values, state_values, sizeof(state_values));
+    ESP_LOGI(TAG, "Journal in sector %u, seq %u, %u of %u bytes used",
+             journal.sector, journal.seq, journal.write_offset, part_flash.sector_size);
+
+    return write_behind_register(&state_client);
+}
@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Raw data partition holding the journal, two sectors used in turn, see partitions.csv */
+#define APP_STATE_PART_NAME         "state"
+#define APP_STATE_PART_SUBTYPE      0x41
+
+#define APP_STATE_MAGIC             0x54534E4B  /* "KNST" */
+
+/* Changes are written once no other change came for this long */
+#ifndef APP_STATE_WRITE_DELAY_MS
+#define APP_STATE_WRITE_DELAY_MS    1000
+#endif
+
+/* A running light timer is stored every this many seconds, it resumes at most this much late */
+#define APP_STATE_TIMER_SAVE_S      30
+
+/* Set to 1 to replay the journal at boot against a RAM flash with a power cut at every few bytes */
+#ifndef APP_STATE_SELFTEST
+#define APP_STATE_SELFTEST          0
+#endif
+
+/**
+ * @brief State of the screens, read when a screen is entered and updated while it is shown
+ */
+typedef enum {
+    APP_STATE_LIGHT_LEVEL,          /*!< 0 - LIGHT_LEVEL_MAX */
+    APP_STATE_THERMOSTAT_TEMP,      /*!< Setpoint in degrees Celsius */
+    APP_STATE_WASH_PROGRAM,         /*!< Index of the selected wash cycle */
+    APP_STATE_LIGHT_TIMER_S,        /*!< Seconds left on the light timer, 0 if it is not running */
+    APP_STATE_FIELD_MAX,
+} app_state_field_t;
+
+typedef struct {
+    uint32_t sets;                  /*!< app_state_set() calls changing a value */
+    uint32_t commits;               /*!< Batches of changes written */
+    uint32_t records;               /*!< Change records appended to the journal */
+    uint32_t compactions;           /*!< Journal sectors rewritten with a snapshot */
+    uint32_t failed;
+} app_state_stats_t;
+
+/**
+ * @brief Read the last state from the journal and register it with the write-behind service
+ *
+ * A journal which can't be read is formatted, the state then starts from its defaults.
+ */
+esp_err_t app_state_init(void);
+
+int32_t app_state_get(app_state_field_t field);
+
+/**
+ * @brief Update a field in RAM, changes are written by the write-behind task after APP_STATE_WRITE_DELAY_MS
+ *
+ * Values out of the range of the field are clamped.
+ */
+void app_state_set(app_state_field_t field, int32_t value);
+
+/**
+ * @brief Set every field back to its default, written like any other change
+ */
+void app_state_reset(void);
+
+/**
+ * @brief Write pending changes now, e.g. before a restart
+ */
+esp_err_t app_state_flush(void);
+
+void app_state_get_stats(app_state_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_bit_defs.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "app_write_behind.h"
+
+static const char *TAG = "write_behind";
+
+static write_behind_client_t *clients[WRITE_BEHIND_CLIENT_MAX];
+static uint8_t client_num;
+
+/* Held across a commit, the task and a flush from another task don't write at the same time */
+static SemaphoreHandle_t commit_mutex;
+static TaskHandle_t commit_task;
+
+static esp_err_t write_behind_run(write_behind_client_t *client, bool force)
+{
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(commit_mutex, portMAX_DELAY);
+    /* Cleared first, a change made during the commit marks the client again */
+    if (client->dirty || force) {
+        client->dirty = false;
+        ret = client->commit();
+    }
+    xSemaphoreGive(commit_mutex);
+    return ret;
+}
+
+static void write_behind_timer_cb(void *arg)
+{
+    write_behind_client_t *client = arg;
+
+    xTaskNotify(commit_task, BIT(client->index), eSetBits);
+}
+
+static void write_behind_task(void *arg)
+{
+    uint32_t due;
+
+    while (1) {
+        xTaskNotifyWait(0, UINT32_MAX, &due, portMAX_DELAY);
+        for (int i = 0; i < client_num; i++) {
+            if (due & BIT(i)) {
+                write_behind_run(clients[i], false);
+            }
+        }
+    }
+}
+
+esp_err_t write_behind_register(write_behind_client_t *client)
+{
+    ESP_RETURN_ON_FALSE(client && client->commit, ESP_ERR_INVALID_ARG, TAG, "bad client");
+    ESP_RETURN_ON_FALSE(client_num < WRITE_BEHIND_CLIENT_MAX, ESP_ERR_NO_MEM, TAG, "too many clients");
+
+    if (NULL == commit_task) {
+        commit_mutex = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(commit_mutex, ESP_ERR_NO_MEM, TAG, "no mem for mutex");
+
+        BaseType_t ret_val = xTaskCreate(write_behind_task, "write_behind", WRITE_BEHIND_TASK_STACK, NULL,
+                                         WRITE_BEHIND_TASK_PRIO, &commit_task);
+        ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_ERR_NO_MEM, TAG, "no mem for task");
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = write_behind_timer_cb,
+        .arg = client,
+        .name = client->name,
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &client->timer), TAG, "no timer for %s", client->name);
+
+    client->dirty = false;
+    client->index = client_num;
+    clients[client_num++] = client;
+    return ESP_OK;
+}
+
+esp_err_t write_behind_mark(write_behind_client_t *client)
+{
+    ESP_RETURN_ON_FALSE(client->timer, ESP_ERR_INVALID_STATE, TAG, "%s not registered", client->name);
+
+    client->dirty = true;
+    /* Every change restarts the window, a burst of changes ends in one commit */
+    esp_timer_stop(client->timer);
+    return esp_timer_start_once(client->timer, client->delay_ms * 1000);
+}
+
+esp_err_t write_behind_flush(write_behind_client_t *client)
+{
+    ESP_RETURN_ON_FALSE(client->timer, ESP_ERR_INVALID_STATE, TAG, "%s not registered", client->name);
+
+    esp_timer_stop(client->timer);
+    return write_behind_run(client, false);
+}
+
+esp_err_t write_behind_commit(write_behind_client_t *client)
+{
+    ESP_RETURN_ON_FALSE(client->timer, ESP_ERR_INVALID_STATE, TAG, "%s not registered", client->name);
+
+    return write_behind_run(client, true);
+}
@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One low priority task commits every client */
+#define WRITE_BEHIND_TASK_PRIO      1
+#define WRITE_BEHIND_TASK_STACK     3072
+#define WRITE_BEHIND_CLIENT_MAX     4
+
+/**
+ * @brief A store written behind its changes, e.g. the settings or the state journal
+ */
+typedef struct {
+    const char *name;
+    uint32_t delay_ms;              /*!< Committed once no change came for this long */
+    esp_err_t (*commit)(void);      /*!< Writes the current values, never called for two clients at once */
+    /* Set by the service */
+    esp_timer_handle_t timer;
+    volatile bool dirty;
+    uint8_t index;
+} write_behind_client_t;
+
+/**
+ * @brief Add a client, the service task is started with the first one
+ */
+esp_err_t write_behind_register(write_behind_client_t *client);
+
+/**
+ * @brief Mark the client changed, takes no lock and can be called from any task
+ */
+esp_err_t write_behind_mark(write_behind_client_t *client);
+
+/**
+ * @brief Commit pending changes of the client now, from the calling task
+ */
+esp_err_t write_behind_flush(write_behind_client_t *client);
+
+/**
+ * @brief Commit the client now whether it changed or not, from the calling task
+ */
+esp_err_t write_behind_commit(write_behind_client_t *client);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,6 +11,7 @@
 #include "driver/rmt_tx.h"
 #include "driver/rmt_rx.h"
 #include "ir_nec_encoder.h"
+#include "app_event_ring.h"
 
 #include "esp_wifi.h"
 
@@ -42,7 +43,7 @@ static const char *TAG = "IR";
 static uint16_t s_nec_code_address;
 static uint16_t s_nec_code_command;
 static uint16_t s_nec_test_id;
-static bool s_nec_test_result = false;
+
 /**
  * @brief Check whether a duration is within expected range
  */
@@ -135,7 +136,7 @@ static void nec_parse_nec_frame(rmt_symbol_word_t *rmt_nec_symbols, size_t symbo
             if (IR_TEST_RESP_ADDR == s_nec_code_address) {
                 if (s_nec_code_command == s_nec_test_id) {
                     printf("@sucesfully, %04X\r\n", s_nec_code_command);
-                    s_nec_test_result = true;
+                    app_event_post(APP_EVENT_PRODUCER_IR, APP_EVENT_IR_TEST_OK, s_nec_code_command);
                 }
             }
         }
@@ -265,11 +266,6 @@ void nec_test_task(void *arg)
     }
 }
 
-bool nec_test_result()
-{
-    return s_nec_test_result;
-}
-
 esp_err_t nec_test_start()
 {
     uint8_t eth_mac[6];
@@ -7,6 +7,7 @@
 
 #pragma once
 
-esp_err_t nec_test_start();
-
-bool nec_test_result();
\ No newline at end of file
+/**
+ * @brief Start sending and receiving the own NEC code, APP_EVENT_IR_TEST_OK is posted once it is received back
+ */
+esp_err_t nec_test_start();
\ No newline at end of file
@@ -4,85 +4,432 @@
  * SPDX-License-Identifier: CC0-1.0
  */
 
+#include <stddef.h>
 #include <string.h>
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "esp_bit_defs.h"
 #include "esp_log.h"
 #include "esp_check.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "bsp/esp-bsp.h"
+#include "app_write_behind.h"
 #include "settings.h"
 
 static const char *TAG = "settings";
 
 #define NAME_SPACE      "sys_param"
-#define KEY             "param"
-#define MAGIC_HEAD      0xAA
+#define VERSION_KEY     "version"
+
+/* Version 0: all settings in one blob */
+#define LEGACY_KEY      "param"
+#define LEGACY_MAGIC    0xAA
+
+typedef struct {
+    uint8_t magic;
+    bool need_hint;
+    uint8_t language;
+} settings_legacy_t;
+
+typedef enum {
+    SETTINGS_TYPE_U8,
+    SETTINGS_TYPE_U16,
+    SETTINGS_TYPE_I16,
+    SETTINGS_TYPE_I32,
+} settings_type_t;
+
+typedef struct {
+    const char *key;                /*!< NVS key, max. 15 characters, never reuse one for another meaning */
+    uint16_t offset;                /*!< Member in sys_param_t */
+    uint8_t type;                   /*!< settings_type_t, the size of the member */
+    int32_t min;
+    int32_t max;
+    int32_t def;                    /*!< Used when the key is missing or out of range */
+} settings_field_t;
+
+#define SETTINGS_FIELD(_key, _member, _type, _min, _max, _def) \
+    { .key = _key, .offset = offsetof(sys_param_t, _member), .type = _type, .min = _min, .max = _max, .def = _def }
+
+static const settings_field_t settings_schema[] = {
+    SETTINGS_FIELD("need_hint", need_hint, SETTINGS_TYPE_U8, 0, 1, 1),
+    SETTINGS_FIELD("language", language, SETTINGS_TYPE_U8, 0, LANGUAGE_MAX - 1, LANGUAGE_EN),
+};
+
+#define SETTINGS_FIELD_NUM      (sizeof(settings_schema) / sizeof(settings_schema[0]))
+#define SETTINGS_FIELD_ALL      ((1U << SETTINGS_FIELD_NUM) - 1)
+
+_Static_assert(SETTINGS_FIELD_NUM < 32, "written fields are tracked in a 32 bit mask");
 
 static sys_param_t g_sys_param = {0};
 
-static const sys_param_t g_default_sys_param = {
-    .magic = MAGIC_HEAD,
-    .need_hint = 1,
-    .language = LANGUAGE_EN,
+/* Content of the flash, fields in g_written_mask are known to hold these values */
+static sys_param_t g_written_sys_param = {0};
+static uint32_t g_written_mask;
+
+static esp_err_t settings_commit(void);
+
+static write_behind_client_t settings_client = {
+    .name = "settings",
+    .delay_ms = SETTINGS_COMMIT_DELAY_MS,
+    .commit = settings_commit,
 };
+static settings_stats_t settings_stats;
+
+static int32_t settings_field_get(const sys_param_t *param, const settings_field_t *field)
+{
+    const uint8_t *p = (const uint8_t *)param + field->offset;
+
+    switch (field->type) {
+    case SETTINGS_TYPE_U8:
+        return *p;
+    case SETTINGS_TYPE_U16:
+        return *(const uint16_t *)p;
+    case SETTINGS_TYPE_I16:
+        return *(const int16_t *)p;
+    default:
+        return *(const int32_t *)p;
+    }
+}
+
+static void settings_field_set(sys_param_t *param, const settings_field_t *field, int32_t value)
+{
+    uint8_t *p = (uint8_t *)param + field->offset;
+
+    switch (field->type) {
+    case SETTINGS_TYPE_U8:
+        *p = value;
+        break;
+    case SETTINGS_TYPE_U16:
+        *(uint16_t *)p = value;
+        break;
+    case SETTINGS_TYPE_I16:
+        *(int16_t *)p = value;
+        break;
+    default:
+        *(int32_t *)p = value;
+        break;
+    }
+}
 
-static esp_err_t settings_check(sys_param_t *param)
+static esp_err_t settings_field_read(nvs_handle_t handle, const settings_field_t *field, int32_t *value)
 {
     esp_err_t ret;
-    ESP_GOTO_ON_FALSE(param->magic == MAGIC_HEAD, ESP_ERR_INVALID_ARG, reset, TAG, "magic incorrect");
-    ESP_GOTO_ON_FALSE(param->language < LANGUAGE_MAX, ESP_ERR_INVALID_ARG, reset, TAG, "language incorrect");
-    return ret;
-reset:
-    ESP_LOGW(TAG, "Set to default");
-    memcpy(&g_sys_param, &g_default_sys_param, sizeof(sys_param_t));
+
+    switch (field->type) {
+    case SETTINGS_TYPE_U8: {
+        uint8_t v;
+        ret = nvs_get_u8(handle, field->key, &v);
+        *value = v;
+        break;
+    }
+    case SETTINGS_TYPE_U16: {
+        uint16_t v;
+        ret = nvs_get_u16(handle, field->key, &v);
+        *value = v;
+        break;
+    }
+    case SETTINGS_TYPE_I16: {
+        int16_t v;
+        ret = nvs_get_i16(handle, field->key, &v);
+        *value = v;
+        break;
+    }
+    default:
+        ret = nvs_get_i32(handle, field->key, value);
+        break;
+    }
     return ret;
 }
 
-esp_err_t settings_read_parameter_from_nvs(void)
+static esp_err_t settings_field_write(nvs_handle_t handle, const settings_field_t *field, int32_t value)
 {
-    nvs_handle_t my_handle = 0;
-    esp_err_t ret = nvs_open(NAME_SPACE, NVS_READONLY, &my_handle);
-    if (ESP_ERR_NVS_NOT_FOUND == ret) {
-        ESP_LOGW(TAG, "Not found, Set to default");
-        memcpy(&g_sys_param, &g_default_sys_param, sizeof(sys_param_t));
-        settings_write_parameter_to_nvs();
+    switch (field->type) {
+    case SETTINGS_TYPE_U8:
+        return nvs_set_u8(handle, field->key, value);
+    case SETTINGS_TYPE_U16:
+        return nvs_set_u16(handle, field->key, value);
+    case SETTINGS_TYPE_I16:
+        return nvs_set_i16(handle, field->key, value);
+    default:
+        return nvs_set_i32(handle, field->key, value);
+    }
+}
+
+static void settings_set_default(sys_param_t *param)
+{
+    for (int i = 0; i < SETTINGS_FIELD_NUM; i++) {
+        settings_field_set(param, &settings_schema[i], settings_schema[i].def);
+    }
+}
+
+/* Fields out of range are set to their default, returns a mask of the fields which were valid */
+static uint32_t settings_check(sys_param_t *param)
+{
+    uint32_t valid = 0;
+
+    for (int i = 0; i < SETTINGS_FIELD_NUM; i++) {
+        const settings_field_t *field = &settings_schema[i];
+        int32_t value = settings_field_get(param, field);
+        if ((value < field->min) || (value > field->max)) {
+            ESP_LOGW(TAG, "%s %d out of range, set to default", field->key, value);
+            settings_field_set(param, field, field->def);
+        } else {
+            valid |= BIT(i);
+        }
+    }
+    return valid;
+}
+
+/* Each migration takes the namespace one version up, it must tolerate being run again after a power loss */
+static esp_err_t settings_migrate_v0(nvs_handle_t handle)
+{
+    settings_legacy_t legacy;
+    size_t len = sizeof(settings_legacy_t);
+    esp_err_t ret = nvs_get_blob(handle, LEGACY_KEY, &legacy, &len);
+
+    if ((ESP_OK == ret) && (sizeof(settings_legacy_t) == len) && (LEGACY_MAGIC == legacy.magic)) {
+        ESP_RETURN_ON_ERROR(nvs_set_u8(handle, "need_hint", legacy.need_hint), TAG, "can't write need_hint");
+        ESP_RETURN_ON_ERROR(nvs_set_u8(handle, "language", legacy.language), TAG, "can't write language");
+    }
+    ret = nvs_erase_key(handle, LEGACY_KEY);
+    return (ESP_ERR_NVS_NOT_FOUND == ret) ? ESP_OK : ret;
+}
+
+static esp_err_t (*const settings_migrations[SETTINGS_VERSION])(nvs_handle_t handle) = {
+    settings_migrate_v0,
+};
+
+static esp_err_t settings_upgrade(nvs_handle_t handle)
+{
+    uint8_t version = 0;
+    esp_err_t ret = nvs_get_u8(handle, VERSION_KEY, &version);
+    ESP_RETURN_ON_FALSE((ESP_OK == ret) || (ESP_ERR_NVS_NOT_FOUND == ret), ret, TAG, "can't read version");
+
+    if (version > SETTINGS_VERSION) {
+        /* Written by a newer firmware, the fields known here are read and range checked as usual */
+        ESP_LOGW(TAG, "Version %u is newer than %u", version, SETTINGS_VERSION);
         return ESP_OK;
     }
 
-    ESP_GOTO_ON_FALSE(ESP_OK == ret, ret, err, TAG, "nvs open failed (0x%x)", ret);
+    for (; version < SETTINGS_VERSION; version++) {
+        ESP_LOGI(TAG, "Migrating from version %u", version);
+        ESP_RETURN_ON_ERROR(settings_migrations[version](handle), TAG, "migration from %u failed", version);
+        ESP_RETURN_ON_ERROR(nvs_set_u8(handle, VERSION_KEY, version + 1), TAG, "can't write version");
+        ESP_RETURN_ON_ERROR(nvs_commit(handle), TAG, "commit failed");
+    }
+    return ESP_OK;
+}
 
-    size_t len = sizeof(sys_param_t);
-    ret = nvs_get_blob(my_handle, KEY, &g_sys_param, &len);
-    ESP_GOTO_ON_FALSE(ESP_OK == ret, ret, err, TAG, "can't read param");
-    nvs_close(my_handle);
+/* Missing keys and values out of range are set to the default, returns a mask of the fields read valid */
+static uint32_t settings_load(nvs_handle_t handle, sys_param_t *param)
+{
+    uint32_t read = 0;
 
-    settings_check(&g_sys_param);
-    return ret;
-err:
-    if (my_handle) {
-        nvs_close(my_handle);
+    for (int i = 0; i < SETTINGS_FIELD_NUM; i++) {
+        const settings_field_t *field = &settings_schema[i];
+        int32_t value = 0;
+        if (ESP_OK == settings_field_read(handle, field, &value)) {
+            read |= BIT(i);
+        } else {
+            value = field->def;
+        }
+        settings_field_set(param, field, value);
     }
-    return ret;
+    return read & settings_check(param);
 }
 
-esp_err_t settings_write_parameter_to_nvs(void)
+/* Writes the fields which differ from the flash content */
+static esp_err_t settings_nvs_write(const sys_param_t *param)
 {
-    ESP_LOGI(TAG, "Saving settings");
-    settings_check(&g_sys_param);
     nvs_handle_t my_handle = {0};
+    uint32_t fields = 0;
     esp_err_t err = nvs_open(NAME_SPACE, NVS_READWRITE, &my_handle);
     if (err != ESP_OK) {
         ESP_LOGI(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
-    } else {
-        err = nvs_set_blob(my_handle, KEY, &g_sys_param, sizeof(sys_param_t));
-        err |= nvs_commit(my_handle);
-        nvs_close(my_handle);
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; (i < SETTINGS_FIELD_NUM) && (ESP_OK == err); i++) {
+        const settings_field_t *field = &settings_schema[i];
+        int32_t value = settings_field_get(param, field);
+        if ((g_written_mask & BIT(i)) && (value == settings_field_get(&g_written_sys_param, field))) {
+            continue;
+        }
+        err = settings_field_write(my_handle, field, value);
+        if (ESP_OK == err) {
+            settings_field_set(&g_written_sys_param, field, value);
+            g_written_mask |= BIT(i);
+            fields++;
+        }
     }
+    err |= nvs_commit(my_handle);
+    nvs_close(my_handle);
+
+    settings_stats.fields += fields;
     return ESP_OK == err ? ESP_OK : ESP_FAIL;
 }
 
+static bool settings_is_written(const sys_param_t *param)
+{
+    if (SETTINGS_FIELD_ALL != g_written_mask) {
+        return false;
+    }
+    for (int i = 0; i < SETTINGS_FIELD_NUM; i++) {
+        if (settings_field_get(param, &settings_schema[i]) != settings_field_get(&g_written_sys_param, &settings_schema[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Called by the write-behind service, which runs one commit at a time */
+static esp_err_t settings_commit(void)
+{
+    sys_param_t param;
+    esp_err_t ret = ESP_OK;
+
+    memcpy(&param, &g_sys_param, sizeof(sys_param_t));
+    settings_check(&param);
+
+    if (settings_is_written(&param)) {
+        settings_stats.unchanged++;
+    } else {
+        ESP_LOGI(TAG, "Saving settings");
+        ret = settings_nvs_write(&param);
+        if (ESP_OK == ret) {
+            settings_stats.writes++;
+        } else {
+            settings_stats.failed++;
+        }
+    }
+    return ret;
+}
+
+esp_err_t settings_write_parameter_to_nvs(void)
+{
+    return write_behind_commit(&settings_client);
+}
+
+esp_err_t settings_save(void)
+{
+    /* Takes no lock, the UI never waits for a commit in progress */
+    settings_stats.saves++;
+    return write_behind_mark(&settings_client);
+}
+
+esp_err_t settings_flush(void)
+{
+    return write_behind_flush(&settings_client);
+}
+
+void settings_get_stats(settings_stats_t *stats)
+{
+    memcpy(stats, &settings_stats, sizeof(settings_stats_t));
+}
+
+#if SETTINGS_SELFTEST
+#define SELFTEST_NAME_SPACE     "settings_test"
+
+/* Runs the migrations and the loading on a namespace of its own */
+static bool settings_selftest_schema(void)
+{
+    const settings_legacy_t legacy = {
+        .magic = LEGACY_MAGIC,
+        .need_hint = 0,
+        .language = LANGUAGE_CN,
+    };
+    nvs_handle_t handle = 0;
+    sys_param_t param;
+    uint8_t version = 0;
+    size_t len = 0;
+    bool ok = true;
+
+    if (ESP_OK != nvs_open(SELFTEST_NAME_SPACE, NVS_READWRITE, &handle)) {
+        return false;
+    }
+    nvs_erase_all(handle);
+
+    /* A blob of version 0 is moved to the field keys and removed */
+    nvs_set_blob(handle, LEGACY_KEY, &legacy, sizeof(settings_legacy_t));
+    ok &= (ESP_OK == settings_upgrade(handle));
+    ok &= (SETTINGS_FIELD_ALL == settings_load(handle, &param));
+    ok &= (0 == param.need_hint) && (LANGUAGE_CN == param.language);
+    ok &= (ESP_OK == nvs_get_u8(handle, VERSION_KEY, &version)) && (SETTINGS_VERSION == version);
+    ok &= (ESP_ERR_NVS_NOT_FOUND == nvs_get_blob(handle, LEGACY_KEY, NULL, &len));
+
+    /* Running the migrations again changes nothing */
+    nvs_set_u8(handle, VERSION_KEY, 0);
+    ok &= (ESP_OK == settings_upgrade(handle));
+    ok &= (SETTINGS_FIELD_ALL == settings_load(handle, &param)) && (LANGUAGE_CN == param.language);
+
+    /* A value out of range and a missing key fall back to their default, the other field is kept */
+    nvs_set_u8(handle, "language", LANGUAGE_MAX);
+    ok &= (BIT(0) == settings_load(handle, &param)) && (LANGUAGE_EN == param.language) && (0 == param.need_hint);
+    nvs_erase_key(handle, "need_hint");
+    ok &= (0 == settings_load(handle, &param)) && (1 == param.need_hint);
+
+    nvs_erase_all(handle);
+    nvs_commit(handle);
+    nvs_close(handle);
+    return ok;
+}
+
+static void settings_selftest(void)
+{
+    settings_stats_t before = settings_stats;
+    bool need_hint = g_sys_param.need_hint;
+    bool schema_ok = settings_selftest_schema();
+
+    /* A burst of changes which ends where it started must not touch the flash */
+    for (int i = 0; i < 50; i++) {
+        g_sys_param.need_hint = !g_sys_param.need_hint;
+        settings_save();
+    }
+    g_sys_param.need_hint = need_hint;
+    settings_save();
+    settings_flush();
+
+    bool ok = (settings_stats.writes == before.writes) && (settings_stats.unchanged == before.unchanged + 1);
+    ESP_LOGI(TAG, "selftest: schema %s, %u saves, %u writes, %u unchanged: %s", schema_ok ? "ok" : "FAIL",
+             settings_stats.saves - before.saves, settings_stats.writes - before.writes,
+             settings_stats.unchanged - before.unchanged, (ok && schema_ok) ? "ok" : "FAIL");
+}
+#endif
+
+esp_err_t settings_read_parameter_from_nvs(void)
+{
+    if (NULL == settings_client.timer) {
+        ESP_RETURN_ON_ERROR(write_behind_register(&settings_client), TAG, "service start failed");
+    }
+
+    nvs_handle_t my_handle = 0;
+    esp_err_t ret = nvs_open(NAME_SPACE, NVS_READWRITE, &my_handle);
+    if (ESP_OK != ret) {
+        ESP_LOGW(TAG, "nvs open failed (0x%x), Set to default", ret);
+        settings_set_default(&g_sys_param);
+        return ret;
+    }
+
+    ret = settings_upgrade(my_handle);
+    if (ESP_OK != ret) {
+        /* The fields already migrated are still read, the rest falls back to the default */
+        ESP_LOGW(TAG, "upgrade to version %u failed (0x%x)", SETTINGS_VERSION, ret);
+    }
+    g_written_mask = settings_load(my_handle, &g_sys_param);
+    memcpy(&g_written_sys_param, &g_sys_param, sizeof(sys_param_t));
+    nvs_close(my_handle);
+
+    /* Store the defaults of missing or invalid fields, so the next boot reads what this one uses */
+    if (SETTINGS_FIELD_ALL != g_written_mask) {
+        ESP_LOGW(TAG, "Fields 0x%x not found, Set to default", SETTINGS_FIELD_ALL & ~g_written_mask);
+        settings_write_parameter_to_nvs();
+    }
+
+#if SETTINGS_SELFTEST
+    settings_selftest();
+#endif
+    return ESP_OK;
+}
+
 sys_param_t *settings_get_parameter(void)
 {
     return &g_sys_param;
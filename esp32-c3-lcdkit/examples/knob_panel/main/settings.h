@@ -6,21 +6,72 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 
+/* A change is committed once no other change came for this long */
+#ifndef SETTINGS_COMMIT_DELAY_MS
+#define SETTINGS_COMMIT_DELAY_MS    2000
+#endif
+
+/*
+ * Version of the settings layout in NVS, bump it with a migration in settings.c when the
+ * key, type or meaning of a stored field changes. Adding a field needs no new version.
+ */
+#define SETTINGS_VERSION            1
+
+/*
+ * Set to 1 to check at boot the migration of the legacy blob, the range check of the fields
+ * and that a burst of changes ending on the stored values is not written
+ */
+#ifndef SETTINGS_SELFTEST
+#define SETTINGS_SELFTEST           0
+#endif
+
 typedef enum {
     LANGUAGE_EN = 0,
     LANGUAGE_CN,
     LANGUAGE_MAX,
 } LANGUAGE_SET;
 
+/**
+ * @brief Settings in RAM, each member is stored under its own NVS key as described by the schema in settings.c
+ */
 typedef struct {
-    uint8_t magic;
     bool need_hint;
     uint8_t language;
 } sys_param_t;
 
+typedef struct {
+    uint32_t saves;                 /*!< settings_save() calls */
+    uint32_t writes;                /*!< Commits written to NVS */
+    uint32_t fields;                /*!< Fields written by these commits */
+    uint32_t unchanged;             /*!< Commits skipped, NVS already held the values */
+    uint32_t failed;
+} settings_stats_t;
+
+/**
+ * @brief Read the settings and register them with the write-behind service
+ */
 esp_err_t settings_read_parameter_from_nvs(void);
+
+/**
+ * @brief Write the changed fields now, from the calling task
+ */
 esp_err_t settings_write_parameter_to_nvs(void);
+
+/**
+ * @brief Mark the settings changed, they are committed by the write-behind task after SETTINGS_COMMIT_DELAY_MS
+ */
+esp_err_t settings_save(void);
+
+/**
+ * @brief Commit pending changes now, e.g. before a restart
+ */
+esp_err_t settings_flush(void);
+
+void settings_get_stats(settings_stats_t *stats);
+
 sys_param_t *settings_get_parameter(void);
 
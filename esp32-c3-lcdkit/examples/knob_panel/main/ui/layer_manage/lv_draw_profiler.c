@@ -0,0 +1,204 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lv_draw_profiler.h"
+
+#if LV_DRAW_PROFILER_ENABLE
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <time.h>
+#endif
+
+typedef struct {
+    const lv_obj_t *obj;
+    const char *type;
+    int64_t start_us;
+    uint32_t time_us;
+    uint32_t post_us;
+    uint32_t px_num;
+    uint32_t draw_cnt;
+} draw_profile_item_t;
+
+static draw_profile_item_t profile_items[LV_DRAW_PROFILER_MAX_OBJS];
+static uint16_t profile_item_num;
+static uint32_t profile_dropped;
+static const char *profile_layer_name;
+
+/* User data of the profiler callbacks, an object carrying it is not hooked twice */
+static const char profiler_tag[] = "draw_profiler";
+
+static inline int64_t profiler_time_us(void)
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static const char *profiler_obj_type(const lv_obj_t *obj)
+{
+    const lv_obj_class_t *class_p = lv_obj_get_class(obj);
+
+    if (&lv_img_class == class_p) {
+        return "img";
+    } else if (&lv_label_class == class_p) {
+        return "label";
+    } else if (&lv_arc_class == class_p) {
+        return "arc";
+    } else if (&lv_roller_class == class_p) {
+        return "roller";
+    } else if (&lv_obj_class == class_p) {
+        return "obj";
+    }
+    return "other";
+}
+
+static draw_profile_item_t *profiler_get_item(const lv_obj_t *obj)
+{
+    for (int i = 0; i < profile_item_num; i++) {
+        if (obj == profile_items[i].obj) {
+            return &profile_items[i];
+        }
+    }
+
+    if (profile_item_num >= LV_DRAW_PROFILER_MAX_OBJS) {
+        profile_dropped++;
+        return NULL;
+    }
+
+    draw_profile_item_t *item = &profile_items[profile_item_num++];
+    memset(item, 0, sizeof(draw_profile_item_t));
+    item->obj = obj;
+    item->type = profiler_obj_type(obj);
+    return item;
+}
+
+static uint32_t profiler_get_px_num(lv_event_t *e, lv_obj_t *obj)
+{
+    lv_area_t obj_area, draw_area;
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+
+    lv_obj_get_coords(obj, &obj_area);
+    lv_coord_t ext_size = _lv_obj_get_ext_draw_size(obj);
+    lv_area_increase(&obj_area, ext_size, ext_size);
+
+    if (!_lv_area_intersect(&draw_area, &obj_area, draw_ctx->clip_area)) {
+        return 0;
+    }
+    return lv_area_get_size(&draw_area);
+}
+
+static void profiler_event_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    lv_obj_t *obj = lv_event_get_target(e);
+
+    draw_profile_item_t *item = profiler_get_item(obj);
+    if (NULL == item) {
+        return;
+    }
+
+    if ((LV_EVENT_DRAW_MAIN_BEGIN == code) || (LV_EVENT_DRAW_POST_BEGIN == code)) {
+        item->start_us = profiler_time_us();
+    } else if (LV_EVENT_DRAW_MAIN_END == code) {
+        item->time_us += (uint32_t)(profiler_time_us() - item->start_us);
+        item->px_num += profiler_get_px_num(e, obj);
+        item->draw_cnt++;
+    } else if (LV_EVENT_DRAW_POST_END == code) {
+        uint32_t post_us = (uint32_t)(profiler_time_us() - item->start_us);
+        item->time_us += post_us;
+        item->post_us += post_us;
+    }
+}
+
+static void profiler_child_created_cb(lv_event_t *e)
+{
+    /* Pages and labels created after the layer was entered, e.g. the washing run page */
+    lv_draw_profiler_attach(lv_event_get_param(e));
+}
+
+void lv_draw_profiler_attach(lv_obj_t *obj)
+{
+    if (NULL == obj) {
+        return;
+    }
+
+    /* Layers left without being deleted keep their hooks, entering them again must not count twice */
+    if (profiler_tag != lv_obj_get_event_user_data(obj, profiler_event_cb)) {
+        lv_obj_add_event_cb(obj, profiler_event_cb, LV_EVENT_DRAW_MAIN_BEGIN, (void *)profiler_tag);
+        lv_obj_add_event_cb(obj, profiler_event_cb, LV_EVENT_DRAW_MAIN_END, (void *)profiler_tag);
+        lv_obj_add_event_cb(obj, profiler_event_cb, LV_EVENT_DRAW_POST_BEGIN, (void *)profiler_tag);
+        lv_obj_add_event_cb(obj, profiler_event_cb, LV_EVENT_DRAW_POST_END, (void *)profiler_tag);
+        lv_obj_add_event_cb(obj, profiler_child_created_cb, LV_EVENT_CHILD_CREATED, NULL);
+    }
+
+    uint32_t child_cnt = lv_obj_get_child_cnt(obj);
+    for (uint32_t i = 0; i < child_cnt; i++) {
+        lv_draw_profiler_attach(lv_obj_get_child(obj, i));
+    }
+}
+
+void lv_draw_profiler_attach_layer(lv_layer_t *layer)
+{
+    profile_item_num = 0;
+    profile_dropped = 0;
+    profile_layer_name = layer->lv_obj_name;
+
+    lv_draw_profiler_attach(layer->lv_obj_layer);
+    if (layer->lv_show_layer) {
+        lv_draw_profiler_attach(layer->lv_show_layer->lv_obj_layer);
+    }
+}
+
+static int profiler_item_cmp(const void *a, const void *b)
+{
+    const draw_profile_item_t *item_a = a;
+    const draw_profile_item_t *item_b = b;
+
+    if (item_a->time_us == item_b->time_us) {
+        return 0;
+    }
+    return (item_a->time_us < item_b->time_us) ? 1 : -1;
+}
+
+void lv_draw_profiler_report(void)
+{
+    uint32_t total_us = 0;
+
+    if (0 == profile_item_num) {
+        return;
+    }
+
+    qsort(profile_items, profile_item_num, sizeof(draw_profile_item_t), profiler_item_cmp);
+    for (int i = 0; i < profile_item_num; i++) {
+        total_us += profile_items[i].time_us;
+    }
+
+    printf("| Draw profile: %s, %d objs, %u us, %u dropped\n",
+           profile_layer_name, profile_item_num, total_us, profile_dropped);
+    printf("| Rank\t| Type\t| Obj\t\t| Draws\t| Time(us)\t| Post(us)\t| Pixels\t| ns/px\t| Share\n");
+    for (int i = 0; i < profile_item_num; i++) {
+        draw_profile_item_t *item = &profile_items[i];
+        if (0 == item->draw_cnt) {
+            continue;
+        }
+        printf("| %d\t| %s\t| %p\t| %u\t| %u\t\t| %u\t\t| %u\t| %u\t| %u%%\n",
+               i + 1, item->type, item->obj, item->draw_cnt, item->time_us, item->post_us, item->px_num,
+               item->px_num ? (uint32_t)((uint64_t)item->time_us * 1000 / item->px_num) : 0,
+               total_us ? (uint32_t)((uint64_t)item->time_us * 100 / total_us) : 0);
+    }
+}
+
+#endif
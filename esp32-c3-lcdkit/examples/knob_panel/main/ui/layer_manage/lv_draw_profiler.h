@@ -0,0 +1,56 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include "lvgl.h"
+#include "lv_schedule_basic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set to 1 (or pass -DLV_DRAW_PROFILER_ENABLE=1) to attribute draw time to widgets */
+#ifndef LV_DRAW_PROFILER_ENABLE
+#define LV_DRAW_PROFILER_ENABLE     0
+#endif
+
+/* Max. number of objects tracked per layer, extra objects are counted as dropped */
+#define LV_DRAW_PROFILER_MAX_OBJS   64
+
+#if LV_DRAW_PROFILER_ENABLE
+
+/**
+ * @brief Reset the statistics and hook the draw events of every object below the layer
+ *
+ * Objects created below the layer later are hooked as they are created, objects
+ * already hooked (e.g. when a kept layer is entered again) are skipped.
+ *
+ * @param layer Layer which is currently shown
+ */
+void lv_draw_profiler_attach_layer(lv_layer_t *layer);
+
+/**
+ * @brief Hook the draw events of an object and its children, and of the children created later
+ */
+void lv_draw_profiler_attach(lv_obj_t *obj);
+
+/**
+ * @brief Print the objects of the profiled layer ranked by accumulated draw time
+ */
+void lv_draw_profiler_report(void);
+
+#else
+
+#define lv_draw_profiler_attach_layer(layer)
+#define lv_draw_profiler_attach(obj)
+#define lv_draw_profiler_report()
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
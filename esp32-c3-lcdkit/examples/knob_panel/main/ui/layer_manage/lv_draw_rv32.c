@@ -0,0 +1,413 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
+
+#include "lv_draw_rv32.h"
+
+static const char *TAG = "draw_rv32";
+
+#if LV_DRAW_RV32_ENABLE && (LV_COLOR_DEPTH == 16)
+
+/*
+ * RGB565 channel access on the raw 16 bit value. With LV_COLOR_16_SWAP the pixels
+ * are kept in panel byte order, so the fields are read in place instead of
+ * swapping every pixel back and forth.
+ */
+#if LV_COLOR_16_SWAP
+#define PX_R(v)             (((v) >> 3) & 0x1F)
+#define PX_G(v)             ((((v) & 0x07) << 3) | ((v) >> 13))
+#define PX_B(v)             (((v) >> 8) & 0x1F)
+#define PX_PACK(r, g, b)    (uint16_t)(((r) << 3) | ((g) >> 3) | ((b) << 8) | (((g) & 0x07) << 13))
+#else
+#define PX_R(v)             ((v) >> 11)
+#define PX_G(v)             (((v) >> 5) & 0x3F)
+#define PX_B(v)             ((v) & 0x1F)
+#define PX_PACK(r, g, b)    (uint16_t)(((r) << 11) | ((g) << 5) | (b))
+#endif
+
+static void (*draw_ctx_init_ori)(struct _lv_disp_drv_t *disp_drv, lv_draw_ctx_t *draw_ctx);
+
+/*
+ * Same result as lv_color_mix(fg, bg, mix), the division by 255 is a multiply and shift.
+ * Without rounding LVGL may take another path (e.g. the 5 bit mix of RGB565), so it is
+ * called as is: the raw value is in the byte order of lv_color_t with or without swap.
+ */
+static inline uint16_t px_mix(uint16_t fg, uint16_t bg, uint32_t mix)
+{
+#if (LV_COLOR_MIX_ROUND_OFS == 0)
+    lv_color_t c1 = {.full = fg}, c2 = {.full = bg};
+    return lv_color_mix(c1, c2, mix).full;
+#else
+    uint32_t inv = 255 - mix;
+    uint32_t r = LV_UDIV255(PX_R(fg) * mix + PX_R(bg) * inv + LV_COLOR_MIX_ROUND_OFS);
+    uint32_t g = LV_UDIV255(PX_G(fg) * mix + PX_G(bg) * inv + LV_COLOR_MIX_ROUND_OFS);
+    uint32_t b = LV_UDIV255(PX_B(fg) * mix + PX_B(bg) * inv + LV_COLOR_MIX_ROUND_OFS);
+    return PX_PACK(r, g, b);
+#endif
+}
+
+static void LV_ATTRIBUTE_FAST_MEM fill_opaque(uint16_t *dest, lv_coord_t dest_stride, lv_coord_t w, lv_coord_t h,
+                                              uint16_t color)
+{
+    uint32_t color32 = ((uint32_t)color << 16) | color;
+
+    for (lv_coord_t y = 0; y < h; y++) {
+        uint16_t *d = dest;
+        lv_coord_t x = w;
+        if (((uintptr_t)d & 0x3) && x) {
+            *d++ = color;
+            x--;
+        }
+        uint32_t *d32 = (uint32_t *)d;
+        for (; x >= 2; x -= 2) {
+            *d32++ = color32;
+        }
+        if (x) {
+            *(uint16_t *)d32 = color;
+        }
+        dest += dest_stride;
+    }
+}
+
+static void LV_ATTRIBUTE_FAST_MEM fill_mask(uint16_t *dest, lv_coord_t dest_stride, lv_coord_t w, lv_coord_t h,
+                                            uint16_t color, const lv_opa_t *mask, lv_coord_t mask_stride)
+{
+    for (lv_coord_t y = 0; y < h; y++) {
+        lv_coord_t x = 0;
+        for (; (x < w) && ((uintptr_t)&mask[x] & 0x3); x++) {
+            if (mask[x] == LV_OPA_COVER) {
+                dest[x] = color;
+            } else if (mask[x]) {
+                dest[x] = px_mix(color, dest[x], mask[x]);
+            }
+        }
+
+        /* Four mask bytes at once: most of a glyph or a rounded edge is fully in or out */
+        for (; x + 4 <= w; x += 4) {
+            uint32_t mask32 = *(const uint32_t *)&mask[x];
+            if (0 == mask32) {
+                continue;
+            } else if (0xFFFFFFFF == mask32) {
+                dest[x] = color;
+                dest[x + 1] = color;
+                dest[x + 2] = color;
+                dest[x + 3] = color;
+                continue;
+            }
+            for (int i = x; i < x + 4; i++) {
+                if (mask[i] == LV_OPA_COVER) {
+                    dest[i] = color;
+                } else if (mask[i]) {
+                    dest[i] = px_mix(color, dest[i], mask[i]);
+                }
+            }
+        }
+
+        for (; x < w; x++) {
+            if (mask[x] == LV_OPA_COVER) {
+                dest[x] = color;
+            } else if (mask[x]) {
+                dest[x] = px_mix(color, dest[x], mask[x]);
+            }
+        }
+        dest += dest_stride;
+        mask += mask_stride;
+    }
+}
+
+static void LV_ATTRIBUTE_FAST_MEM map_opaque(uint16_t *dest, lv_coord_t dest_stride, lv_coord_t w, lv_coord_t h,
+                                             const uint16_t *src, lv_coord_t src_stride)
+{
+    for (lv_coord_t y = 0; y < h; y++) {
+        memcpy(dest, src, w * sizeof(uint16_t));
+        dest += dest_stride;
+        src += src_stride;
+    }
+}
+
+static inline void map_copy4(uint16_t *dest, const uint16_t *src)
+{
+    if (0 == (((uintptr_t)dest | (uintptr_t)src) & 0x3)) {
+        ((uint32_t *)dest)[0] = ((const uint32_t *)src)[0];
+        ((uint32_t *)dest)[1] = ((const uint32_t *)src)[1];
+    } else {
+        dest[0] = src[0];
+        dest[1] = src[1];
+        dest[2] = src[2];
+        dest[3] = src[3];
+    }
+}
+
+/* The alpha channel of TRUE_COLOR_ALPHA images arrives here as the mask */
+static void LV_ATTRIBUTE_FAST_MEM map_mask(uint16_t *dest, lv_coord_t dest_stride, lv_coord_t w, lv_coord_t h,
+                                           const uint16_t *src, lv_coord_t src_stride,
+                                           const lv_opa_t *mask, lv_coord_t mask_stride)
+{
+    for (lv_coord_t y = 0; y < h; y++) {
+        lv_coord_t x = 0;
+        for (; (x < w) && ((uintptr_t)&mask[x] & 0x3); x++) {
+            if (mask[x] == LV_OPA_COVER) {
+                dest[x] = src[x];
+            } else if (mask[x]) {
+                dest[x] = px_mix(src[x], dest[x], mask[x]);
+            }
+        }
+
+        for (; x + 4 <= w; x += 4) {
+            uint32_t mask32 = *(const uint32_t *)&mask[x];
+            if (0 == mask32) {
+                continue;
+            } else if (0xFFFFFFFF == mask32) {
+                map_copy4(&dest[x], &src[x]);
+                continue;
+            }
+            for (int i = x; i < x + 4; i++) {
+                if (mask[i] == LV_OPA_COVER) {
+                    dest[i] = src[i];
+                } else if (mask[i]) {
+                    dest[i] = px_mix(src[i], dest[i], mask[i]);
+                }
+            }
+        }
+
+        for (; x < w; x++) {
+            if (mask[x] == LV_OPA_COVER) {
+                dest[x] = src[x];
+            } else if (mask[x]) {
+                dest[x] = px_mix(src[x], dest[x], mask[x]);
+            }
+        }
+        dest += dest_stride;
+        src += src_stride;
+        mask += mask_stride;
+    }
+}
+
+/* Mirrors the clipping of lv_draw_sw_blend_basic() for the cases handled above */
+static void LV_ATTRIBUTE_FAST_MEM draw_rv32_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+
+    if ((dsc->opa < LV_OPA_MAX) || (LV_BLEND_MODE_NORMAL != dsc->blend_mode) ||
+            disp->driver->set_px_cb || disp->driver->screen_transp) {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+
+    const lv_opa_t *mask = dsc->mask_buf;
+    if (mask && (LV_DRAW_MASK_RES_TRANSP == dsc->mask_res)) {
+        return;
+    } else if (LV_DRAW_MASK_RES_FULL_COVER == dsc->mask_res) {
+        mask = NULL;
+    }
+
+    lv_area_t blend_area;
+    if (!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area)) {
+        return;
+    }
+
+    lv_coord_t w = lv_area_get_width(&blend_area);
+    lv_coord_t h = lv_area_get_height(&blend_area);
+
+    lv_coord_t dest_stride = lv_area_get_width(draw_ctx->buf_area);
+    uint16_t *dest = (uint16_t *)draw_ctx->buf;
+    dest += dest_stride * (blend_area.y1 - draw_ctx->buf_area->y1) + (blend_area.x1 - draw_ctx->buf_area->x1);
+
+    lv_coord_t mask_stride = 0;
+    if (mask) {
+        mask_stride = lv_area_get_width(dsc->mask_area);
+        mask += mask_stride * (blend_area.y1 - dsc->mask_area->y1) + (blend_area.x1 - dsc->mask_area->x1);
+    }
+
+    if (NULL == dsc->src_buf) {
+        if (mask) {
+            fill_mask(dest, dest_stride, w, h, dsc->color.full, mask, mask_stride);
+        } else {
+            fill_opaque(dest, dest_stride, w, h, dsc->color.full);
+        }
+        return;
+    }
+
+    lv_coord_t src_stride = lv_area_get_width(dsc->blend_area);
+    const uint16_t *src = (const uint16_t *)dsc->src_buf;
+    src += src_stride * (blend_area.y1 - dsc->blend_area->y1) + (blend_area.x1 - dsc->blend_area->x1);
+
+    if (mask) {
+        map_mask(dest, dest_stride, w, h, src, src_stride, mask, mask_stride);
+    } else {
+        map_opaque(dest, dest_stride, w, h, src, src_stride);
+    }
+}
+
+/* Draw contexts created later (snapshots, static backings) get the kernels too */
+static void draw_rv32_ctx_init(lv_disp_drv_t *disp_drv, lv_draw_ctx_t *draw_ctx)
+{
+    draw_ctx_init_ori(disp_drv, draw_ctx);
+    ((lv_draw_sw_ctx_t *)draw_ctx)->blend = draw_rv32_blend;
+}
+
+#if LV_DRAW_RV32_SELFTEST
+
+#define SELFTEST_W          64
+#define SELFTEST_H          32
+#define SELFTEST_PX         (SELFTEST_W * SELFTEST_H)
+#define SELFTEST_LOOPS      50
+
+static uint32_t selftest_mix(void)
+{
+    uint32_t fail = 0;
+
+    for (uint32_t mix = 1; mix < LV_OPA_COVER; mix++) {
+        for (int i = 0; i < 64; i++) {
+            uint32_t rnd = esp_random();
+            lv_color_t fg = {.full = rnd & 0xFFFF}, bg = {.full = rnd >> 16};
+            if (px_mix(fg.full, bg.full, mix) != lv_color_mix(fg, bg, mix).full) {
+                fail++;
+            }
+        }
+    }
+    return fail;
+}
+
+static void selftest_fill_mask(lv_opa_t *mask)
+{
+    /* Runs of transparent, opaque and anti-aliased pixels like a decoded icon */
+    for (int i = 0; i < SELFTEST_PX; i++) {
+        uint32_t run = (i / 7) % 3;
+        mask[i] = (0 == run) ? LV_OPA_TRANSP : (1 == run) ? LV_OPA_COVER : (esp_random() & 0xFF);
+    }
+}
+
+static void selftest_blend(const char *name, lv_draw_ctx_t *draw_ctx, lv_draw_sw_blend_dsc_t *dsc,
+                           lv_color_t *dest_ref, lv_color_t *dest)
+{
+    lv_color_t *dest_init = heap_caps_malloc(SELFTEST_PX * sizeof(lv_color_t), MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    if (NULL == dest_init) {
+        return;
+    }
+    for (int i = 0; i < SELFTEST_PX; i++) {
+        dest_init[i].full = esp_random();
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < SELFTEST_LOOPS; i++) {
+        memcpy(dest_ref, dest_init, SELFTEST_PX * sizeof(lv_color_t));
+        draw_ctx->buf = dest_ref;
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+    }
+    int64_t ref_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < SELFTEST_LOOPS; i++) {
+        memcpy(dest, dest_init, SELFTEST_PX * sizeof(lv_color_t));
+        draw_ctx->buf = dest;
+        draw_rv32_blend(draw_ctx, dsc);
+    }
+    int64_t rv32_us = esp_timer_get_time() - start;
+
+    /* Both include the same memcpy of the destination */
+    bool exact = (0 == memcmp(dest_ref, dest, SELFTEST_PX * sizeof(lv_color_t)));
+    ESP_LOGI(TAG, "%-12s %s, sw %d px/ms, rv32 %d px/ms", name, exact ? "bit-exact" : "MISMATCH",
+             (int)(SELFTEST_PX * SELFTEST_LOOPS * 1000LL / LV_MAX(ref_us, 1)),
+             (int)(SELFTEST_PX * SELFTEST_LOOPS * 1000LL / LV_MAX(rv32_us, 1)));
+    heap_caps_free(dest_init);
+}
+
+static void draw_rv32_selftest(lv_disp_t *disp)
+{
+    uint32_t mix_fail = selftest_mix();
+    ESP_LOGI(TAG, "color mix: %s (%u mismatches)", mix_fail ? "MISMATCH" : "bit-exact", mix_fail);
+
+    lv_color_t *dest_ref = heap_caps_malloc(SELFTEST_PX * sizeof(lv_color_t), MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    lv_color_t *dest = heap_caps_malloc(SELFTEST_PX * sizeof(lv_color_t), MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    lv_color_t *src = heap_caps_malloc(SELFTEST_PX * sizeof(lv_color_t), MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    lv_opa_t *mask = heap_caps_malloc(SELFTEST_PX, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    if (!dest_ref || !dest || !src || !mask) {
+        ESP_LOGW(TAG, "no mem for selftest");
+        goto exit;
+    }
+    for (int i = 0; i < SELFTEST_PX; i++) {
+        src[i].full = esp_random();
+    }
+    selftest_fill_mask(mask);
+
+    /* Odd offsets so that the unaligned head and tail paths are covered too */
+    lv_area_t buf_area = {0, 0, SELFTEST_W - 1, SELFTEST_H - 1};
+    lv_area_t clip_area = {1, 1, SELFTEST_W - 2, SELFTEST_H - 2};
+    lv_area_t blend_area = {1, 0, SELFTEST_W - 1, SELFTEST_H - 1};
+
+    lv_draw_sw_ctx_t sw_ctx;
+    lv_memset_00(&sw_ctx, sizeof(sw_ctx));
+    lv_draw_ctx_t *draw_ctx = &sw_ctx.base_draw;
+    draw_ctx->buf_area = &buf_area;
+    draw_ctx->clip_area = &clip_area;
+
+    lv_draw_sw_blend_dsc_t dsc;
+    lv_memset_00(&dsc, sizeof(dsc));
+    dsc.blend_area = &blend_area;
+    dsc.mask_area = &blend_area;
+    dsc.opa = LV_OPA_COVER;
+    dsc.blend_mode = LV_BLEND_MODE_NORMAL;
+    dsc.color = lv_color_make(0x30, 0xA0, 0xE0);
+
+    lv_disp_t *refr_ori = _lv_refr_get_disp_refreshing();
+    _lv_refr_set_disp_refreshing(disp);
+
+    dsc.mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+    selftest_blend("fill", draw_ctx, &dsc, dest_ref, dest);
+
+    dsc.mask_buf = mask;
+    dsc.mask_res = LV_DRAW_MASK_RES_CHANGED;
+    selftest_blend("fill mask", draw_ctx, &dsc, dest_ref, dest);
+
+    dsc.src_buf = src;
+    dsc.mask_buf = NULL;
+    dsc.mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+    selftest_blend("copy", draw_ctx, &dsc, dest_ref, dest);
+
+    dsc.mask_buf = mask;
+    dsc.mask_res = LV_DRAW_MASK_RES_CHANGED;
+    selftest_blend("alpha blend", draw_ctx, &dsc, dest_ref, dest);
+
+    _lv_refr_set_disp_refreshing(refr_ori);
+
+exit:
+    heap_caps_free(dest_ref);
+    heap_caps_free(dest);
+    heap_caps_free(src);
+    heap_caps_free(mask);
+}
+#endif
+
+void lv_draw_rv32_init(lv_disp_t *disp)
+{
+    if (draw_rv32_ctx_init == disp->driver->draw_ctx_init) {
+        return;
+    }
+
+    draw_ctx_init_ori = disp->driver->draw_ctx_init;
+    disp->driver->draw_ctx_init = draw_rv32_ctx_init;
+    ((lv_draw_sw_ctx_t *)disp->driver->draw_ctx)->blend = draw_rv32_blend;
+    ESP_LOGI(TAG, "RGB565 blend kernels enabled, swap %d", LV_COLOR_16_SWAP);
+
+#if LV_DRAW_RV32_SELFTEST
+    draw_rv32_selftest(disp);
+#endif
+}
+
+#else
+
+void lv_draw_rv32_init(lv_disp_t *disp)
+{
+    ESP_LOGI(TAG, "RGB565 blend kernels disabled");
+}
+
+#endif
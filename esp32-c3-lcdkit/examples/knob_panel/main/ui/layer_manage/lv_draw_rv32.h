@@ -0,0 +1,39 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set to 0 (or pass -DLV_DRAW_RV32_ENABLE=0) to render with the plain lv_draw_sw blend */
+#ifndef LV_DRAW_RV32_ENABLE
+#define LV_DRAW_RV32_ENABLE         1
+#endif
+
+/* Set to 1 to compare the kernels against lv_draw_sw and benchmark them at init */
+#ifndef LV_DRAW_RV32_SELFTEST
+#define LV_DRAW_RV32_SELFTEST       0
+#endif
+
+/**
+ * @brief Replace the software blend of the display with the RGB565 word kernels
+ *
+ * Opaque fill, opaque copy and masked (alpha) fill / copy in normal blend mode are
+ * handled here, everything else falls back to lv_draw_sw_blend_basic().
+ *
+ * @note Call with the LVGL lock held, after the display is registered.
+ *
+ * @param disp Display to accelerate
+ */
+void lv_draw_rv32_init(lv_disp_t *disp);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,158 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "esp_log.h"
+
+#include "lv_encoder_input.h"
+#include "lv_latency_trace.h"
+
+#if LV_ENCODER_INPUT_SELFTEST
+static const char *TAG = "encoder_input";
+#endif
+
+static lv_indev_t *enc_indev;
+static void (*enc_read_orig)(lv_indev_drv_t *drv, lv_indev_data_t *data);
+static uint32_t enc_last_tick;
+
+/* Delta of the key event being sent, valid while enc_sending */
+static bool enc_sending;
+static int32_t enc_steps;
+static int32_t enc_accel_steps;
+
+static int32_t encoder_accel(int32_t diff, uint32_t elapsed_ms)
+{
+    uint32_t rate = LV_ABS(diff) * 1000 / LV_MAX(elapsed_ms, 1);
+    int32_t mult = 1;
+
+    if (rate > LV_ENCODER_ACCEL_START) {
+        mult = LV_MIN(1 + (int32_t)(rate - LV_ENCODER_ACCEL_START) / LV_ENCODER_ACCEL_SLOPE, LV_ENCODER_ACCEL_MAX);
+    }
+    return diff * mult;
+}
+
+static void encoder_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    enc_read_orig(drv, data);
+
+    /* LVGL drops detents while pressed and uses them to move the focus outside editing mode */
+    lv_group_t *group = enc_indev->group;
+    if ((0 == data->enc_diff) || (LV_INDEV_STATE_PRESSED == data->state) || enc_indev->proc.disabled ||
+            (NULL == group) || !lv_group_get_editing(group) || (NULL == lv_group_get_focused(group))) {
+        return;
+    }
+
+    uint32_t elapsed = lv_tick_elaps(enc_last_tick);
+    enc_last_tick = lv_tick_get();
+    enc_steps = data->enc_diff;
+    enc_accel_steps = encoder_accel(enc_steps, elapsed);
+    data->enc_diff = 0;
+
+#if LV_ENCODER_INPUT_SELFTEST
+    ESP_LOGI(TAG, "%d detents after %d ms -> %d steps", (int)enc_steps, (int)elapsed, (int)enc_accel_steps);
+#endif
+
+    lv_latency_trace_key();
+    enc_sending = true;
+    lv_group_send_data(group, (enc_steps > 0) ? LV_KEY_RIGHT : LV_KEY_LEFT);
+    enc_sending = false;
+}
+
+#if LV_ENCODER_INPUT_SELFTEST
+typedef struct {
+    uint16_t elapsed_ms;
+    int8_t diff;
+} trace_read_t;
+
+#define TRACE(t, slow)  {t, sizeof(t) / sizeof(t[0]), slow}
+
+/* A fast spin, detents per read every SPIN_READ_MS, across a range like the brightness */
+#define SPIN_READ_MS    30
+#define SPIN_READ_DIFF  2
+#define SPIN_RANGE      100
+
+/* Reads of the indev: time since the previous read with detents and the detents read */
+static const trace_read_t trace_slow[] = {{300, 1}, {250, 1}, {400, -1}, {200, 1}, {1000, -1}};
+static const trace_read_t trace_fast[] = {{30, 2}, {30, 3}, {30, -1}, {30, 4}, {30, 2}, {30, 1}};
+static const trace_read_t trace_reverse[] = {{1000, 1}, {30, 1}, {30, 1}, {60, -1}, {30, -2}, {500, -1}};
+
+static const struct {
+    const trace_read_t *reads;
+    int num;
+    bool slow;                      /*!< Every read below LV_ENCODER_ACCEL_START, no detent may be scaled */
+} traces[] = {TRACE(trace_slow, true), TRACE(trace_fast, false), TRACE(trace_reverse, false)};
+
+static void encoder_input_selftest(void)
+{
+    bool fail = false;
+
+    for (int t = 0; t < sizeof(traces) / sizeof(traces[0]); t++) {
+        int32_t detents = 0, accel_steps = 0;
+        bool ok = true;
+
+        for (int i = 0; i < traces[t].num; i++) {
+            int32_t diff = traces[t].reads[i].diff;
+            int32_t accel = encoder_accel(diff, traces[t].reads[i].elapsed_ms);
+
+            /* Same direction, at least one step and at most the max. per detent */
+            if ((accel * diff <= 0) || (LV_ABS(accel) < LV_ABS(diff)) ||
+                    (LV_ABS(accel) > LV_ABS(diff) * LV_ENCODER_ACCEL_MAX)) {
+                ok = false;
+            }
+            detents += diff;
+            accel_steps += accel;
+        }
+        /* At multiplier 1 the coalesced reads must add up to the detents turned */
+        if (traces[t].slow && (accel_steps != detents)) {
+            ok = false;
+        }
+        fail |= !ok;
+        ESP_LOGI(TAG, "trace %d: %d detents -> %d steps: %s", t, (int)detents, (int)accel_steps, ok ? "ok" : "FAIL");
+    }
+
+    int reads = 0, accel_reads = 0;
+    for (int32_t pos = 0; pos < SPIN_RANGE; reads++) {
+        pos += SPIN_READ_DIFF;
+    }
+    for (int32_t pos = 0; pos < SPIN_RANGE; accel_reads++) {
+        pos += encoder_accel(SPIN_READ_DIFF, SPIN_READ_MS);
+    }
+    fail |= (accel_reads >= reads);
+    ESP_LOGI(TAG, "spin across %d: %d reads, %d accelerated: %s", SPIN_RANGE, reads, accel_reads,
+             (accel_reads < reads) ? "ok" : "FAIL");
+    ESP_LOGI(TAG, "selftest: %s", fail ? "FAIL" : "ok");
+}
+#endif
+
+void lv_encoder_input_init(lv_indev_t *indev)
+{
+    if ((NULL == indev) || (LV_INDEV_TYPE_ENCODER != lv_indev_get_type(indev)) || enc_indev) {
+        return;
+    }
+
+    enc_indev = indev;
+    enc_read_orig = indev->driver->read_cb;
+    indev->driver->read_cb = encoder_read_cb;
+    enc_last_tick = lv_tick_get();
+
+#if LV_ENCODER_INPUT_SELFTEST
+    encoder_input_selftest();
+#endif
+}
+
+int32_t lv_encoder_input_get_steps(lv_event_t *e)
+{
+    if (enc_sending) {
+        return enc_steps;
+    }
+
+    uint32_t key = lv_event_get_key(e);
+    return (LV_KEY_RIGHT == key) ? 1 : ((LV_KEY_LEFT == key) ? -1 : 0);
+}
+
+int32_t lv_encoder_input_get_accel_steps(lv_event_t *e)
+{
+    return enc_sending ? enc_accel_steps : lv_encoder_input_get_steps(e);
+}
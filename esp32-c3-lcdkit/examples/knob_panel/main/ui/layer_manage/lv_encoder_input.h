@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Detents per second where acceleration starts, below it one detent is one step */
+#ifndef LV_ENCODER_ACCEL_START
+#define LV_ENCODER_ACCEL_START      8
+#endif
+
+/* Detents per second above the start that add one step per detent */
+#ifndef LV_ENCODER_ACCEL_SLOPE
+#define LV_ENCODER_ACCEL_SLOPE      8
+#endif
+
+/* Max. steps per detent */
+#ifndef LV_ENCODER_ACCEL_MAX
+#define LV_ENCODER_ACCEL_MAX        5
+#endif
+
+/* Set to 1 to check the acceleration curve on synthetic detent traces at init and to log every
+ * coalesced read, e.g. to tune the curve */
+#ifndef LV_ENCODER_INPUT_SELFTEST
+#define LV_ENCODER_INPUT_SELFTEST   0
+#endif
+
+/**
+ * @brief Coalesce the encoder detents of one read into one key event
+ *
+ * Wraps the read callback of the indev: in editing mode all detents read at once are sent to the
+ * focused object as a single LV_KEY_LEFT / LV_KEY_RIGHT, the event handler gets the count with
+ * lv_encoder_input_get_steps(). Outside editing mode and while pressed LVGL handles them as before.
+ *
+ * @param indev Encoder input device
+ */
+void lv_encoder_input_init(lv_indev_t *indev);
+
+/**
+ * @brief Signed detent count of an LV_EVENT_KEY, positive for LV_KEY_RIGHT
+ *
+ * Keys not sent by the encoder, e.g. lv_group_send_data(), count as one detent.
+ */
+int32_t lv_encoder_input_get_steps(lv_event_t *e);
+
+/**
+ * @brief Like lv_encoder_input_get_steps() with the velocity acceleration applied
+ *
+ * For values adjusted over a wide range; lists that step per item use the detent count.
+ */
+int32_t lv_encoder_input_get_accel_steps(lv_event_t *e);
+
+#ifdef __cplusplus
+}
+#endif
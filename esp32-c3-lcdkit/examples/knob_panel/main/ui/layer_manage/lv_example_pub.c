@@ -14,6 +14,8 @@
 
 #include "lvgl.h"
 #include "lv_example_pub.h"
+#include "lv_encoder_input.h"
+#include "lv_input_replay.h"
 
 static const char *TAG = "LVGL_PUB";
 
@@ -38,5 +40,7 @@ void ui_obj_to_encoder_init(void)
         ESP_LOGI(TAG, "add group for encoder");
         lv_indev_set_group(indev, group);
         lv_group_focus_freeze(group, false);
+        lv_input_replay_init(indev);
+        lv_encoder_input_init(indev);
     }
 }
@@ -0,0 +1,437 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+
+#include "lv_example_pub.h"
+#include "lv_frame_monitor.h"
+#include "lv_frame_check.h"
+
+#if LV_FRAME_CHECK_ENABLE
+
+static const char *TAG = "frame_check";
+
+#define CHECK_TIMER_PERIOD      10
+#define CHECK_BOOT_DELAY        4000    /* boot animation and language/menu entry */
+#define CHECK_ENTER_DELAY       1500    /* entry animations are not budgeted */
+
+typedef enum {
+    CHECK_OP_KEY_LEFT,
+    CHECK_OP_KEY_RIGHT,
+    CHECK_OP_CLICK,
+    CHECK_OP_LONG_PRESS,
+    CHECK_OP_WAIT,
+    CHECK_OP_CAPTURE,
+    CHECK_OP_END,
+} check_op_t;
+
+typedef struct {
+    check_op_t op;
+    uint16_t arg;   /* repeat count for keys, ms for waits */
+} check_step_t;
+
+/* Max. CHECK_OP_CAPTURE steps of one screen */
+#define CHECK_CAPTURE_MAX   4
+
+/* Signatures of the CHECK_OP_CAPTURE steps of a screen, in order */
+typedef struct {
+    uint8_t num;                    /*!< Captures recorded, 0 until recorded on the panel */
+    uint8_t sig[CHECK_CAPTURE_MAX][LV_FRAME_CHECK_SIG_SIZE];
+} check_golden_t;
+
+typedef struct {
+    lv_layer_t *layer;
+    uint32_t budget_ms;
+    uint32_t budget_px;
+    const check_step_t *steps;
+    const check_golden_t *golden;
+} check_screen_t;
+
+typedef enum {
+    CHECK_STATE_BOOT,
+    CHECK_STATE_ENTER,
+    CHECK_STATE_WAIT,
+    CHECK_STATE_STEP,
+    CHECK_STATE_CAPTURE,
+    CHECK_STATE_DONE,
+} check_state_t;
+
+#define KEY_STEP_INTERVAL   250
+
+static const check_step_t menu_steps[] = {
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_KEY_RIGHT, 3},
+    {CHECK_OP_WAIT, 300},
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_KEY_LEFT, 1},
+    {CHECK_OP_WAIT, 300},
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_END, 0},
+};
+
+static const check_step_t thermostat_steps[] = {
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_KEY_RIGHT, 4},
+    {CHECK_OP_WAIT, 600},
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_KEY_LEFT, 6},
+    {CHECK_OP_WAIT, 600},
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_END, 0},
+};
+
+static const check_step_t light_steps[] = {
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_KEY_RIGHT, 2},
+    {CHECK_OP_WAIT, 300},
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_KEY_LEFT, 4},
+    {CHECK_OP_WAIT, 300},
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_END, 0},
+};
+
+static const check_step_t washing_steps[] = {
+    {CHECK_OP_KEY_RIGHT, 1},
+    {CHECK_OP_WAIT, 600},
+    {CHECK_OP_KEY_LEFT, 2},
+    {CHECK_OP_WAIT, 600},
+    {CHECK_OP_CLICK, 0},
+    {CHECK_OP_WAIT, 2000},
+    {CHECK_OP_LONG_PRESS, 0},
+    {CHECK_OP_WAIT, 500},
+    {CHECK_OP_LONG_PRESS, 0},
+    {CHECK_OP_WAIT, 500},
+    {CHECK_OP_END, 0},
+};
+
+static const check_step_t language_steps[] = {
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_KEY_RIGHT, 1},
+    {CHECK_OP_WAIT, 300},
+    {CHECK_OP_CAPTURE, 0},
+    {CHECK_OP_KEY_RIGHT, 1},
+    {CHECK_OP_WAIT, 300},
+    {CHECK_OP_END, 0},
+};
+
+/*
+ * Golden signatures of each screen. A screen whose captures are not recorded or don't match
+ * prints its table when it is left: run a known good build on the panel and paste the printed
+ * initializer here. Until then its captures are reported as not recorded and the run does not pass.
+ */
+static const check_golden_t menu_golden = {0};
+static const check_golden_t thermostat_golden = {0};
+static const check_golden_t light_golden = {0};
+static const check_golden_t language_golden = {0};
+
+static const check_screen_t check_screens[] = {
+    {&menu_layer,           30, 240 * 240, menu_steps,       &menu_golden},
+    {&thermostat_Layer,     40, 240 * 240, thermostat_steps, &thermostat_golden},
+    {&light_2color_Layer,   30, 240 * 240, light_steps,      &light_golden},
+    {&washing_Layer,        40, 240 * 160, washing_steps,    NULL},
+    {&language_Layer,       30, 240 * 120, language_steps,   &language_golden},
+};
+
+#define CHECK_SCREEN_NUM    (sizeof(check_screens) / sizeof(check_screens[0]))
+
+static lv_timer_t *check_timer;
+static check_state_t check_state;
+static uint8_t screen_index, step_index, capture_index;
+static uint16_t step_repeat;
+static time_out_count time_wait;
+
+static uint32_t over_budget_cnt, golden_fail_cnt, unrecorded_cnt;
+static uint32_t fail_screens, unrecorded_screens;
+static uint8_t captured[CHECK_CAPTURE_MAX][LV_FRAME_CHECK_SIG_SIZE];
+static bool capture_pending, capture_done;
+static uint32_t sig_sum[LV_FRAME_CHECK_SIG_SIZE];
+static uint32_t sig_cnt[LV_FRAME_CHECK_SIG_SIZE];
+
+static void check_flush_cb(const lv_area_t *area, const lv_color_t *color_p)
+{
+    if (!capture_pending) {
+        return;
+    }
+
+    lv_coord_t hor_res = LV_HOR_RES;
+    lv_coord_t ver_res = LV_VER_RES;
+    for (lv_coord_t y = area->y1; y <= area->y2; y++) {
+        uint32_t row = y * LV_FRAME_CHECK_GRID / ver_res;
+        for (lv_coord_t x = area->x1; x <= area->x2; x++) {
+            uint32_t cell = row * LV_FRAME_CHECK_GRID + x * LV_FRAME_CHECK_GRID / hor_res;
+            sig_sum[cell] += lv_color_brightness(*color_p++);
+            sig_cnt[cell]++;
+        }
+    }
+}
+
+static void check_frame_cb(uint32_t render_ms, uint32_t flush_px)
+{
+    const check_screen_t *screen = &check_screens[screen_index];
+
+    if (capture_pending) {
+        /* the capture redraws the whole screen on purpose, it is not budgeted */
+        capture_pending = false;
+        capture_done = true;
+        return;
+    }
+
+    if ((CHECK_STATE_ENTER == check_state) || (CHECK_STATE_BOOT == check_state) || (CHECK_STATE_DONE == check_state)) {
+        return;
+    }
+
+    if ((render_ms > screen->budget_ms) || (flush_px > screen->budget_px)) {
+        over_budget_cnt++;
+        ESP_LOGW(TAG, "[%s] step %d over budget: %u ms (max %u), %u px (max %u)",
+                 screen->layer->lv_obj_name, step_index, render_ms, screen->budget_ms, flush_px, screen->budget_px);
+    }
+}
+
+static void check_capture_start(void)
+{
+    memset(sig_sum, 0, sizeof(sig_sum));
+    memset(sig_cnt, 0, sizeof(sig_cnt));
+    capture_done = false;
+    capture_pending = true;
+    lv_obj_invalidate(lv_scr_act());
+}
+
+static void check_capture_finish(const check_screen_t *screen)
+{
+    uint8_t sig[LV_FRAME_CHECK_SIG_SIZE];
+
+    for (int i = 0; i < LV_FRAME_CHECK_SIG_SIZE; i++) {
+        sig[i] = sig_cnt[i] ? (sig_sum[i] / sig_cnt[i]) : 0;
+    }
+
+    if (capture_index >= CHECK_CAPTURE_MAX) {
+        ESP_LOGW(TAG, "[%s] more than %d captures", screen->layer->lv_obj_name, CHECK_CAPTURE_MAX);
+        golden_fail_cnt++;
+        return;
+    }
+    memcpy(captured[capture_index], sig, sizeof(sig));
+
+    if ((NULL == screen->golden) || (capture_index >= screen->golden->num)) {
+        unrecorded_cnt++;
+        ESP_LOGW(TAG, "[%s] frame %d: golden not recorded", screen->layer->lv_obj_name, capture_index);
+    } else {
+        const uint8_t *golden = screen->golden->sig[capture_index];
+        int diff_max = 0, diff_cell = 0, diff_num = 0;
+        for (int i = 0; i < LV_FRAME_CHECK_SIG_SIZE; i++) {
+            int diff = LV_ABS((int)sig[i] - (int)golden[i]);
+            if (diff > LV_FRAME_CHECK_TOLERANCE) {
+                diff_num++;
+            }
+            if (diff > diff_max) {
+                diff_max = diff;
+                diff_cell = i;
+            }
+        }
+        if (diff_num) {
+            golden_fail_cnt++;
+            ESP_LOGW(TAG, "[%s] frame %d differs from golden in %d cells, cell %d off by %d",
+                     screen->layer->lv_obj_name, capture_index, diff_num, diff_cell, diff_max);
+        }
+    }
+    capture_index++;
+}
+
+/* Prints the captures of the screen as a check_golden_t initializer, to be pasted as its golden */
+static void check_golden_print(const check_screen_t *screen)
+{
+    printf("/* %s golden */ {\n    %d, {\n", screen->layer->lv_obj_name, capture_index);
+    for (int n = 0; n < capture_index; n++) {
+        printf("        {");
+        for (int i = 0; i < LV_FRAME_CHECK_SIG_SIZE; i++) {
+            printf("%s%u", i ? ", " : "", captured[n][i]);
+        }
+        printf("},\n");
+    }
+    printf("    }\n}\n");
+}
+
+static void check_screen_enter(const check_screen_t *screen)
+{
+    ESP_LOGI(TAG, "[%s] enter", screen->layer->lv_obj_name);
+    ui_remove_all_objs_from_encoder_group();
+    lv_func_goto_layer(screen->layer);
+
+    step_index = 0;
+    step_repeat = 0;
+    capture_index = 0;
+    over_budget_cnt = 0;
+    golden_fail_cnt = 0;
+    unrecorded_cnt = 0;
+    set_time_out(&time_wait, CHECK_ENTER_DELAY);
+    check_state = CHECK_STATE_ENTER;
+}
+
+static void check_screen_leave(const check_screen_t *screen)
+{
+    lv_frame_stats_t stats;
+    lv_frame_monitor_get_stats(&stats);
+
+    if (screen->golden && (capture_index < screen->golden->num)) {
+        ESP_LOGW(TAG, "[%s] %d goldens for %d captures", screen->layer->lv_obj_name, screen->golden->num, capture_index);
+        golden_fail_cnt++;
+    }
+
+    const char *result = "PASS";
+    if (over_budget_cnt || golden_fail_cnt) {
+        fail_screens++;
+        result = "FAIL";
+    } else if (unrecorded_cnt) {
+        unrecorded_screens++;
+        result = "NOT RECORDED";
+    }
+    ESP_LOGI(TAG, "[%s] %s: %u frames, avg %u ms, max %u ms, max %u px, %u over budget, "
+             "%u golden mismatch, %u not recorded",
+             screen->layer->lv_obj_name, result, stats.frame_cnt,
+             stats.frame_cnt ? stats.render_ms_sum / stats.frame_cnt : 0, stats.render_ms_max,
+             stats.flush_px_max, over_budget_cnt, golden_fail_cnt, unrecorded_cnt);
+    if (golden_fail_cnt || unrecorded_cnt) {
+        check_golden_print(screen);
+    }
+}
+
+static void check_send_key(check_op_t op)
+{
+    lv_group_t *group = lv_group_get_default();
+    lv_obj_t *focused = lv_group_get_focused(group);
+
+    if (NULL == focused) {
+        return;
+    }
+
+    switch (op) {
+    case CHECK_OP_KEY_LEFT:
+        lv_group_send_data(group, LV_KEY_LEFT);
+        break;
+    case CHECK_OP_KEY_RIGHT:
+        lv_group_send_data(group, LV_KEY_RIGHT);
+        break;
+    case CHECK_OP_CLICK:
+        lv_event_send(focused, LV_EVENT_CLICKED, NULL);
+        break;
+    case CHECK_OP_LONG_PRESS:
+        lv_event_send(focused, LV_EVENT_LONG_PRESSED, NULL);
+        break;
+    default:
+        break;
+    }
+}
+
+static void check_step(const check_screen_t *screen)
+{
+    const check_step_t *step = &screen->steps[step_index];
+
+    switch (step->op) {
+    case CHECK_OP_KEY_LEFT:
+    case CHECK_OP_KEY_RIGHT:
+        if (is_time_out(&time_wait)) {
+            check_send_key(step->op);
+            if (++step_repeat >= step->arg) {
+                step_repeat = 0;
+                step_index++;
+            }
+        }
+        break;
+    case CHECK_OP_CLICK:
+    case CHECK_OP_LONG_PRESS:
+        check_send_key(step->op);
+        step_index++;
+        break;
+    case CHECK_OP_WAIT:
+        set_time_out(&time_wait, step->arg);
+        check_state = CHECK_STATE_WAIT;
+        step_index++;
+        break;
+    case CHECK_OP_CAPTURE:
+        check_capture_start();
+        check_state = CHECK_STATE_CAPTURE;
+        break;
+    case CHECK_OP_END:
+        check_screen_leave(screen);
+        if (++screen_index < CHECK_SCREEN_NUM) {
+            check_screen_enter(&check_screens[screen_index]);
+        } else {
+            check_state = CHECK_STATE_DONE;
+        }
+        break;
+    }
+}
+
+static void check_timer_cb(lv_timer_t *tmr)
+{
+    feed_clock_time();
+
+    switch (check_state) {
+    case CHECK_STATE_BOOT:
+        if (is_time_out(&time_wait)) {
+            check_screen_enter(&check_screens[screen_index]);
+        }
+        break;
+    case CHECK_STATE_ENTER:
+        if (is_time_out(&time_wait)) {
+            lv_frame_monitor_reset();
+            set_time_out(&time_wait, KEY_STEP_INTERVAL);
+            check_state = CHECK_STATE_STEP;
+        }
+        break;
+    case CHECK_STATE_WAIT:
+        if (is_time_out(&time_wait)) {
+            set_time_out(&time_wait, KEY_STEP_INTERVAL);
+            check_state = CHECK_STATE_STEP;
+        }
+        break;
+    case CHECK_STATE_STEP:
+        check_step(&check_screens[screen_index]);
+        break;
+    case CHECK_STATE_CAPTURE:
+        if (capture_done) {
+            check_capture_finish(&check_screens[screen_index]);
+            step_index++;
+            check_state = CHECK_STATE_STEP;
+        }
+        break;
+    case CHECK_STATE_DONE:
+        ESP_LOGI(TAG, "%s: %u of %d screens failed, %u not recorded", (fail_screens || unrecorded_screens) ? "FAIL" : "PASS",
+                 fail_screens, CHECK_SCREEN_NUM, unrecorded_screens);
+        lv_frame_monitor_set_frame_cb(NULL);
+        lv_frame_monitor_set_flush_cb(NULL);
+        lv_timer_del(check_timer);
+        check_timer = NULL;
+        ui_remove_all_objs_from_encoder_group();
+        lv_func_goto_layer(&menu_layer);
+        break;
+    }
+}
+
+void lv_frame_check_start(lv_disp_t *disp)
+{
+    lv_frame_monitor_init(disp);
+    lv_frame_monitor_set_frame_cb(check_frame_cb);
+    lv_frame_monitor_set_flush_cb(check_flush_cb);
+
+    screen_index = 0;
+    fail_screens = 0;
+    unrecorded_screens = 0;
+    check_state = CHECK_STATE_BOOT;
+    set_time_out(&time_wait, CHECK_BOOT_DELAY);
+    check_timer = lv_timer_create(check_timer_cb, CHECK_TIMER_PERIOD, NULL);
+    ESP_LOGI(TAG, "Replaying %d screens", CHECK_SCREEN_NUM);
+}
+
+#else
+
+void lv_frame_check_start(lv_disp_t *disp)
+{
+}
+
+#endif
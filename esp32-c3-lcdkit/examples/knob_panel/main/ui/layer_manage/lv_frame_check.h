@@ -0,0 +1,39 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set to 1 (or pass -DLV_FRAME_CHECK_ENABLE=1) to replay the screen scripts after boot */
+#ifndef LV_FRAME_CHECK_ENABLE
+#define LV_FRAME_CHECK_ENABLE       0
+#endif
+
+/* Frame signature: mean brightness of a grid of cells covering the screen */
+#define LV_FRAME_CHECK_GRID         8
+#define LV_FRAME_CHECK_SIG_SIZE     (LV_FRAME_CHECK_GRID * LV_FRAME_CHECK_GRID)
+
+/* Max. brightness difference of one cell against the golden signature */
+#define LV_FRAME_CHECK_TOLERANCE    12
+
+/**
+ * @brief Replay the encoder script of every screen, check frame budgets and golden frames
+ *
+ * Runs from an LVGL timer, results are logged per screen. Must be called before
+ * lv_create_clock(), otherwise its timer is deleted by the first layer switch.
+ *
+ * @param disp Display which frames are checked
+ */
+void lv_frame_check_start(lv_disp_t *disp);
+
+#ifdef __cplusplus
+}
+#endif
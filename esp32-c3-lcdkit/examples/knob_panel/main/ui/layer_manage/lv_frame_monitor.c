@@ -0,0 +1,141 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "lv_frame_monitor.h"
+
+static const char *TAG = "frame_monitor";
+
+static void (*disp_flush_ori)(struct _lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p);
+static void (*disp_monitor_ori)(struct _lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px);
+static void (*disp_wait_ori)(struct _lv_disp_drv_t *disp_drv);
+
+static lv_disp_t *monitor_disp;
+static lv_frame_stats_t frame_stats;
+static uint32_t frame_flush_px, frame_flush_cnt, frame_wait_us;
+
+/* wait_cb is polled while LVGL spins on a busy draw buffer, first and last poll of the spin */
+static int64_t wait_start, wait_last;
+
+static lv_frame_monitor_frame_cb_t frame_cb;
+static lv_frame_monitor_flush_cb_t flush_cb;
+
+static void frame_monitor_wait_end(void)
+{
+    if (wait_start) {
+        frame_wait_us += wait_last - wait_start;
+        wait_start = 0;
+    }
+}
+
+static void frame_monitor_wait(lv_disp_drv_t *disp_drv)
+{
+    wait_last = esp_timer_get_time();
+    if (0 == wait_start) {
+        wait_start = wait_last;
+    }
+
+    if (disp_wait_ori) {
+        disp_wait_ori(disp_drv);
+    }
+}
+
+static void frame_monitor_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    uint32_t px = lv_area_get_size(area);
+
+    frame_monitor_wait_end();
+    frame_flush_px += px;
+    frame_flush_cnt++;
+    frame_stats.flush_bytes_max = LV_MAX(frame_stats.flush_bytes_max, px * sizeof(lv_color_t));
+
+    if (flush_cb) {
+        flush_cb(area, color_p);
+    }
+    disp_flush_ori(disp_drv, area, color_p);
+}
+
+static void frame_monitor_monitor(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px)
+{
+    frame_stats.frame_cnt++;
+    frame_stats.render_ms_sum += time;
+    frame_stats.render_ms_max = LV_MAX(frame_stats.render_ms_max, time);
+    frame_stats.flush_px_sum += frame_flush_px;
+    frame_stats.flush_px_max = LV_MAX(frame_stats.flush_px_max, frame_flush_px);
+    frame_stats.flush_cnt += frame_flush_cnt;
+    frame_stats.flush_cnt_max = LV_MAX(frame_stats.flush_cnt_max, frame_flush_cnt);
+    frame_monitor_wait_end();
+    frame_stats.wait_us_sum += frame_wait_us;
+    frame_stats.wait_us_max = LV_MAX(frame_stats.wait_us_max, frame_wait_us);
+
+    if (frame_cb) {
+        frame_cb(time, frame_flush_px);
+    }
+    frame_flush_px = 0;
+    frame_flush_cnt = 0;
+    frame_wait_us = 0;
+
+    if (disp_monitor_ori) {
+        disp_monitor_ori(disp_drv, time, px);
+    }
+}
+
+void lv_frame_monitor_init(lv_disp_t *disp)
+{
+    /* Other hooks may wrap ours, so its flush_cb tells nothing */
+    if (monitor_disp) {
+        return;
+    }
+    monitor_disp = disp;
+
+    disp_flush_ori = disp->driver->flush_cb;
+    disp_monitor_ori = disp->driver->monitor_cb;
+    disp_wait_ori = disp->driver->wait_cb;
+    disp->driver->flush_cb = frame_monitor_flush;
+    disp->driver->monitor_cb = frame_monitor_monitor;
+    disp->driver->wait_cb = frame_monitor_wait;
+    ESP_LOGI(TAG, "Hooked display %p", disp);
+}
+
+void lv_frame_monitor_reset(void)
+{
+    memset(&frame_stats, 0, sizeof(lv_frame_stats_t));
+}
+
+void lv_frame_monitor_get_stats(lv_frame_stats_t *stats)
+{
+    memcpy(stats, &frame_stats, sizeof(lv_frame_stats_t));
+}
+
+void lv_frame_monitor_report(const char *name)
+{
+    lv_frame_stats_t *st = &frame_stats;
+    uint32_t frame_cnt = LV_MAX(st->frame_cnt, 1);
+    uint32_t flush_cnt = LV_MAX(st->flush_cnt, 1);
+    uint64_t flush_bytes = (uint64_t)st->flush_px_sum * sizeof(lv_color_t);
+    uint32_t spi_us = flush_bytes * 8 * 1000000ULL / LV_FRAME_MONITOR_SPI_HZ / frame_cnt;
+
+    ESP_LOGI(TAG, "[%s] %u frames, render avg %u ms max %u ms", name,
+             st->frame_cnt, st->render_ms_sum / frame_cnt, st->render_ms_max);
+    ESP_LOGI(TAG, "[%s] flush/frame avg %u max %u, bytes/flush avg %u max %u",
+             name, st->flush_cnt / frame_cnt, st->flush_cnt_max,
+             (uint32_t)(flush_bytes / flush_cnt), st->flush_bytes_max);
+    ESP_LOGI(TAG, "[%s] wait/frame avg %u us max %u us, modelled SPI %u us/frame at %u MHz",
+             name, st->wait_us_sum / frame_cnt, st->wait_us_max, spi_us, LV_FRAME_MONITOR_SPI_HZ / 1000000);
+}
+
+void lv_frame_monitor_set_frame_cb(lv_frame_monitor_frame_cb_t cb)
+{
+    frame_cb = cb;
+}
+
+void lv_frame_monitor_set_flush_cb(lv_frame_monitor_flush_cb_t cb)
+{
+    flush_cb = cb;
+}
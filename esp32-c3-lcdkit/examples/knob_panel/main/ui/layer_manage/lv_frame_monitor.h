@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Panel SPI clock used to model the transfer time in lv_frame_monitor_report() */
+#ifndef LV_FRAME_MONITOR_SPI_HZ
+#define LV_FRAME_MONITOR_SPI_HZ     (40 * 1000 * 1000)
+#endif
+
+/**
+ * @brief Frame statistics accumulated since the last lv_frame_monitor_reset()
+ */
+typedef struct {
+    uint32_t frame_cnt;         /*!< Number of refreshes which redrew something */
+    uint32_t render_ms_sum;     /*!< Sum of render times reported by LVGL */
+    uint32_t render_ms_max;     /*!< Slowest frame */
+    uint32_t flush_px_sum;      /*!< Pixels handed to the panel */
+    uint32_t flush_px_max;      /*!< Most pixels flushed by one frame */
+    uint32_t flush_cnt;         /*!< Number of flush_cb calls */
+    uint32_t flush_cnt_max;     /*!< Most flush_cb calls of one frame */
+    uint32_t flush_bytes_max;   /*!< Largest single flush */
+    uint32_t wait_us_sum;       /*!< Time LVGL spent waiting for a draw buffer to be flushed */
+    uint32_t wait_us_max;       /*!< Longest wait of one frame */
+} lv_frame_stats_t;
+
+/**
+ * @brief Called from the LVGL task after each refreshed frame
+ */
+typedef void (*lv_frame_monitor_frame_cb_t)(uint32_t render_ms, uint32_t flush_px);
+
+/**
+ * @brief Called from the LVGL task with every area before it is sent to the panel
+ */
+typedef void (*lv_frame_monitor_flush_cb_t)(const lv_area_t *area, const lv_color_t *color_p);
+
+/**
+ * @brief Hook the monitor, flush and wait callbacks of the display driver
+ *
+ * @note Call once after the display is registered, the original callbacks are still called.
+ */
+void lv_frame_monitor_init(lv_disp_t *disp);
+
+void lv_frame_monitor_reset(void);
+
+void lv_frame_monitor_get_stats(lv_frame_stats_t *stats);
+
+/**
+ * @brief Log the statistics, with the SPI transfer time modelled from the flushed bytes
+ *
+ * @param name Label printed with the statistics, e.g. the buffer strategy
+ */
+void lv_frame_monitor_report(const char *name);
+
+void lv_frame_monitor_set_frame_cb(lv_frame_monitor_frame_cb_t cb);
+
+void lv_frame_monitor_set_flush_cb(lv_frame_monitor_flush_cb_t cb);
+
+#ifdef __cplusplus
+}
+#endif
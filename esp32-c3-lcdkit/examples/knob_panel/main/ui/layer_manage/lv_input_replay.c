@@ -0,0 +1,323 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_console.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "bsp/esp-bsp.h"
+
+#include "lv_example_pub.h"
+#include "lv_frame_monitor.h"
+#include "lv_latency_trace.h"
+#include "lv_input_replay.h"
+
+#if LV_INPUT_REPLAY_ENABLE
+
+static const char *TAG = "input_replay";
+
+#define NAME_SPACE      "input_trace"
+#define KEY             "trace"
+
+typedef enum {
+    REPLAY_MODE_IDLE,
+    REPLAY_MODE_RECORD,
+    REPLAY_MODE_PLAY,
+} replay_mode_t;
+
+static struct __attribute__((packed)) {
+    lv_input_trace_head_t head;
+    lv_input_record_t rec[LV_INPUT_REPLAY_MAX];
+} trace;
+
+static void (*replay_read_orig)(lv_indev_drv_t *drv, lv_indev_data_t *data);
+static replay_mode_t replay_mode;
+
+/* Recording: tick and button state of the previous record */
+static uint32_t rec_tick;
+static uint8_t rec_state;
+
+/* Replay: start tick, recorded time of the records fed so far, next record and button state */
+static uint32_t play_tick;
+static uint32_t play_due_ms;
+static uint16_t play_index;
+static uint16_t play_speed;
+static uint8_t play_state;
+
+static bool replay_record_add(uint16_t dt_ms, int32_t enc_diff, uint8_t state)
+{
+    if (trace.head.num >= LV_INPUT_REPLAY_MAX) {
+        ESP_LOGW(TAG, "Trace full after %u records, recording stopped", trace.head.num);
+        replay_mode = REPLAY_MODE_IDLE;
+        return false;
+    }
+
+    lv_input_record_t *rec = &trace.rec[trace.head.num++];
+    rec->dt_ms = dt_ms;
+    rec->enc_diff = LV_CLAMP(INT8_MIN, enc_diff, INT8_MAX);
+    rec->state = state;
+    return true;
+}
+
+static void replay_record(const lv_indev_data_t *data)
+{
+    uint32_t now = lv_tick_get();
+    uint32_t dt = now - rec_tick;
+
+    rec_tick = now;
+    /* Idle longer than a record can tell */
+    for (; dt > UINT16_MAX; dt -= UINT16_MAX) {
+        if (!replay_record_add(UINT16_MAX, 0, rec_state)) {
+            return;
+        }
+    }
+    if (replay_record_add(dt, data->enc_diff, data->state)) {
+        rec_state = data->state;
+    }
+}
+
+static void replay_finish(void)
+{
+    replay_mode = REPLAY_MODE_IDLE;
+    ESP_LOGI(TAG, "Replayed %u records in %u ms at %u%%", trace.head.num, lv_tick_elaps(play_tick), play_speed);
+    lv_frame_monitor_report("replay");
+    lv_latency_trace_report();
+}
+
+static void replay_play(lv_indev_data_t *data)
+{
+    uint32_t elapsed = (uint64_t)lv_tick_elaps(play_tick) * play_speed / 100;
+    bool fed = false;
+
+    /* The knob is ignored while replaying */
+    data->enc_diff = 0;
+    while (play_index < trace.head.num) {
+        const lv_input_record_t *rec = &trace.rec[play_index];
+        if (play_due_ms + rec->dt_ms > elapsed) {
+            break;
+        }
+        /* A press or release starts a read of its own, LVGL sees one state per read */
+        if (fed && (rec->state != play_state)) {
+            break;
+        }
+        play_due_ms += rec->dt_ms;
+        play_state = rec->state;
+        data->enc_diff += rec->enc_diff;
+        play_index++;
+        fed = true;
+    }
+
+    /* A read after the last record, let go of the button if the trace ended pressed */
+    if ((play_index >= trace.head.num) && !fed) {
+        play_state = LV_INDEV_STATE_RELEASED;
+        replay_finish();
+    }
+    data->state = play_state;
+}
+
+static void replay_read_cb(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    replay_read_orig(drv, data);
+
+    if (REPLAY_MODE_RECORD == replay_mode) {
+        if (data->enc_diff || (data->state != rec_state)) {
+            replay_record(data);
+        }
+    } else if (REPLAY_MODE_PLAY == replay_mode) {
+        replay_play(data);
+    }
+}
+
+static void replay_goto_menu(void)
+{
+    ui_remove_all_objs_from_encoder_group();
+    lv_func_goto_layer(&menu_layer);
+}
+
+static esp_err_t replay_load(void)
+{
+    nvs_handle_t handle = 0;
+    esp_err_t ret = nvs_open(NAME_SPACE, NVS_READONLY, &handle);
+    ESP_RETURN_ON_ERROR(ret, TAG, "no trace recorded");
+
+    size_t len = sizeof(trace);
+    ret = nvs_get_blob(handle, KEY, &trace, &len);
+    nvs_close(handle);
+    ESP_RETURN_ON_ERROR(ret, TAG, "can't read trace");
+
+    if ((LV_INPUT_REPLAY_MAGIC != trace.head.magic) || (LV_INPUT_REPLAY_VERSION != trace.head.version) ||
+            (len != sizeof(lv_input_trace_head_t) + trace.head.num * sizeof(lv_input_record_t))) {
+        trace.head.num = 0;
+        ESP_LOGE(TAG, "trace invalid");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t replay_save(void)
+{
+    nvs_handle_t handle = 0;
+    esp_err_t ret = nvs_open(NAME_SPACE, NVS_READWRITE, &handle);
+    ESP_RETURN_ON_ERROR(ret, TAG, "nvs open failed");
+
+    ret = nvs_set_blob(handle, KEY, &trace, sizeof(lv_input_trace_head_t) + trace.head.num * sizeof(lv_input_record_t));
+    if (ESP_OK == ret) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    ESP_RETURN_ON_ERROR(ret, TAG, "can't write trace");
+    return ESP_OK;
+}
+
+esp_err_t lv_input_record_start(void)
+{
+    ESP_RETURN_ON_FALSE(replay_read_orig, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    bsp_display_lock(0);
+    replay_goto_menu();
+    trace.head.magic = LV_INPUT_REPLAY_MAGIC;
+    trace.head.version = LV_INPUT_REPLAY_VERSION;
+    trace.head.num = 0;
+    rec_tick = lv_tick_get();
+    rec_state = LV_INDEV_STATE_RELEASED;
+    replay_mode = REPLAY_MODE_RECORD;
+    bsp_display_unlock();
+
+    ESP_LOGI(TAG, "Recording");
+    return ESP_OK;
+}
+
+esp_err_t lv_input_record_stop(void)
+{
+    bsp_display_lock(0);
+    if (REPLAY_MODE_RECORD == replay_mode) {
+        replay_mode = REPLAY_MODE_IDLE;
+    }
+    uint32_t num = trace.head.num;
+    bsp_display_unlock();
+
+    ESP_RETURN_ON_FALSE(num, ESP_ERR_INVALID_STATE, TAG, "nothing recorded");
+    ESP_LOGI(TAG, "Saving %u records", num);
+    return replay_save();
+}
+
+esp_err_t lv_input_replay_start(uint16_t speed_pct)
+{
+    ESP_RETURN_ON_FALSE(replay_read_orig, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(speed_pct, ESP_ERR_INVALID_ARG, TAG, "speed 0");
+    ESP_RETURN_ON_FALSE(REPLAY_MODE_IDLE == replay_mode, ESP_ERR_INVALID_STATE, TAG, "busy");
+    if (0 == trace.head.num) {
+        ESP_RETURN_ON_ERROR(replay_load(), TAG, "no trace to replay");
+    }
+
+    bsp_display_lock(0);
+    replay_goto_menu();
+    lv_frame_monitor_init(lv_disp_get_default());
+    lv_frame_monitor_reset();
+    lv_latency_trace_reset();
+    play_tick = lv_tick_get();
+    play_due_ms = 0;
+    play_index = 0;
+    play_speed = speed_pct;
+    play_state = LV_INDEV_STATE_RELEASED;
+    replay_mode = REPLAY_MODE_PLAY;
+    bsp_display_unlock();
+
+    ESP_LOGI(TAG, "Replaying %u records at %u%%", trace.head.num, speed_pct);
+    return ESP_OK;
+}
+
+void lv_input_replay_stop(void)
+{
+    bsp_display_lock(0);
+    if (REPLAY_MODE_PLAY == replay_mode) {
+        replay_finish();
+    }
+    bsp_display_unlock();
+}
+
+static int replay_cmd(int argc, char **argv)
+{
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+    if (argc < 2) {
+        uint32_t ms = 0;
+        for (int i = 0; i < trace.head.num; i++) {
+            ms += trace.rec[i].dt_ms;
+        }
+        printf("%u records, %u ms, %s\n", trace.head.num, ms,
+               (REPLAY_MODE_RECORD == replay_mode) ? "recording" : (REPLAY_MODE_PLAY == replay_mode) ? "replaying" : "idle");
+        return 0;
+    } else if (0 == strcmp(argv[1], "record")) {
+        ret = lv_input_record_start();
+    } else if (0 == strcmp(argv[1], "stop")) {
+        if (REPLAY_MODE_PLAY == replay_mode) {
+            lv_input_replay_stop();
+            ret = ESP_OK;
+        } else {
+            ret = lv_input_record_stop();
+        }
+    } else if (0 == strcmp(argv[1], "play")) {
+        ret = lv_input_replay_start((argc > 2) ? atoi(argv[2]) : 100);
+    }
+    return (ESP_OK == ret) ? 0 : 1;
+}
+
+esp_err_t lv_input_replay_register_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "replay",
+        .help = "Record the knob to NVS (record, stop) or replay it (play [speed %], stop), no argument prints the trace",
+        .hint = "[record|play [speed]|stop]",
+        .func = &replay_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+
+void lv_input_replay_init(lv_indev_t *indev)
+{
+    if ((NULL == indev) || replay_read_orig) {
+        return;
+    }
+
+    replay_read_orig = indev->driver->read_cb;
+    indev->driver->read_cb = replay_read_cb;
+}
+
+#else
+
+void lv_input_replay_init(lv_indev_t *indev)
+{
+}
+
+esp_err_t lv_input_record_start(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t lv_input_record_stop(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t lv_input_replay_start(uint16_t speed_pct)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void lv_input_replay_stop(void)
+{
+}
+
+esp_err_t lv_input_replay_register_cmd(void)
+{
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set to 1 to record knob input to NVS and replay it, controlled by the "replay" console command */
+#ifndef LV_INPUT_REPLAY_ENABLE
+#define LV_INPUT_REPLAY_ENABLE      0
+#endif
+
+/* Max. records of a trace, 4 bytes each */
+#define LV_INPUT_REPLAY_MAX         1024
+
+#define LV_INPUT_REPLAY_MAGIC       0x54424E4B  /* "KNBT" */
+#define LV_INPUT_REPLAY_VERSION     1
+
+/**
+ * @brief One change of the encoder read by LVGL
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t dt_ms;             /*!< Time since the previous record */
+    int8_t enc_diff;            /*!< Detents read */
+    uint8_t state;              /*!< lv_indev_state_t of the button */
+} lv_input_record_t;
+
+/**
+ * @brief Trace as stored in NVS, followed by num records
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num;
+} lv_input_trace_head_t;
+
+/**
+ * @brief Hook the read callback of the encoder
+ *
+ * @note Call before lv_encoder_input_init(), so replayed detents are coalesced and accelerated like real ones.
+ */
+void lv_input_replay_init(lv_indev_t *indev);
+
+/**
+ * @brief Go to the menu and record the knob from there on, until lv_input_record_stop()
+ */
+esp_err_t lv_input_record_start(void);
+
+/**
+ * @brief Stop recording and save the trace to NVS
+ */
+esp_err_t lv_input_record_stop(void);
+
+/**
+ * @brief Go to the menu and feed the saved trace to LVGL instead of the knob
+ *
+ * The frame statistics (and latencies if traced) are reset at the start and reported at the end.
+ *
+ * @param speed_pct Playback speed, 100 for the recorded timing
+ */
+esp_err_t lv_input_replay_start(uint16_t speed_pct);
+
+void lv_input_replay_stop(void);
+
+/**
+ * @brief Register the "replay" console command
+ */
+esp_err_t lv_input_replay_register_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,362 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_console.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "bsp/esp-bsp.h"
+
+#include "lv_example_pub.h"
+#include "lv_frame_monitor.h"
+#include "lv_latency_trace.h"
+
+#if LV_LATENCY_TRACE
+
+static const char *TAG = "latency";
+
+/* Turns waiting for their frame, more only when keys come faster than frames */
+#define LATENCY_OPEN            4
+
+/* Period of the check for the end of a frame transfer still running when the frame is done */
+#define LATENCY_FLUSH_POLL_MS   1
+
+/* Columns of a sample: the total, the time of each stage after the previous and the modelled flush */
+#define COL_TOTAL               0
+#define COL_MODEL               LV_LATENCY_STAGE_NUM
+#define COL_NUM                 (LV_LATENCY_STAGE_NUM + 1)
+
+typedef struct {
+    uint32_t id;
+    uint8_t screen;
+    int64_t t[LV_LATENCY_STAGE_NUM];
+} latency_event_t;
+
+typedef struct {
+    const char *name;
+    uint32_t count;
+    uint32_t no_redraw;
+    uint32_t us[LV_LATENCY_SAMPLES][COL_NUM];
+} latency_screen_t;
+
+static const char *col_name[COL_NUM] = {
+    "total", "edge>key", "key>invalidate", "invalidate>render", "render>flush", "flush model",
+};
+
+static lv_disp_t *trace_disp;
+static void (*disp_flush_ori)(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p);
+static void (*disp_monitor_ori)(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px);
+static void (*disp_rounder_ori)(lv_disp_drv_t *disp_drv, lv_area_t *area);
+
+static latency_event_t events[LATENCY_OPEN];
+static uint32_t event_id;
+static latency_screen_t screens[LV_LATENCY_SCREENS];
+
+/* Last area handed to the panel in the running frame */
+static int64_t flush_last_us;
+static uint32_t flush_last_px;
+
+/* Frame rendered while its last area is still being transferred, closed by the next flush or the poll timer */
+static bool flush_pending;
+static uint32_t flush_pending_model_us;
+static lv_timer_t *flush_poll_timer;
+
+static portMUX_TYPE edge_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t edge_us;
+
+static void IRAM_ATTR latency_edge_isr(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&edge_lock);
+    if (0 == edge_us) {
+        edge_us = now;
+    }
+    portEXIT_CRITICAL_ISR(&edge_lock);
+}
+
+static uint8_t latency_screen_index(void)
+{
+    lv_layer_t *layer = lv_func_get_current_layer();
+    const char *name = layer ? layer->lv_obj_name : "none";
+
+    for (int i = 0; i < LV_LATENCY_SCREENS; i++) {
+        if ((NULL == screens[i].name) || (0 == strcmp(screens[i].name, name))) {
+            screens[i].name = name;
+            return i;
+        }
+    }
+    /* Out of slots, the last one collects the rest */
+    return LV_LATENCY_SCREENS - 1;
+}
+
+static void latency_event_close(latency_event_t *ev, uint32_t model_us)
+{
+    latency_screen_t *screen = &screens[ev->screen];
+    uint32_t *us = screen->us[screen->count % LV_LATENCY_SAMPLES];
+
+    us[COL_TOTAL] = ev->t[LV_LATENCY_FLUSH] - ev->t[LV_LATENCY_EDGE];
+    for (int s = LV_LATENCY_KEY; s < LV_LATENCY_STAGE_NUM; s++) {
+        us[s] = ev->t[s] - ev->t[s - 1];
+    }
+    us[COL_MODEL] = model_us;
+    screen->count++;
+    ESP_LOGD(TAG, "#%u %s: %u us, key +%u, invalidate +%u, render +%u, flush +%u", ev->id, screen->name,
+             us[COL_TOTAL], us[LV_LATENCY_KEY], us[LV_LATENCY_INVALIDATE], us[LV_LATENCY_RENDER], us[LV_LATENCY_FLUSH]);
+    ev->id = 0;
+}
+
+static void latency_expire(int64_t now)
+{
+    for (int i = 0; i < LATENCY_OPEN; i++) {
+        if (events[i].id && (0 == events[i].t[LV_LATENCY_INVALIDATE]) &&
+                (now - events[i].t[LV_LATENCY_KEY] > LV_LATENCY_TIMEOUT_MS * 1000)) {
+            screens[events[i].screen].no_redraw++;
+            events[i].id = 0;
+        }
+    }
+}
+
+static void latency_rounder(lv_disp_drv_t *disp_drv, lv_area_t *area)
+{
+    if (disp_rounder_ori) {
+        disp_rounder_ori(disp_drv, area);
+    }
+
+    /* LVGL also rounds while rendering, only invalidations count */
+    if (trace_disp->rendering_in_progress) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < LATENCY_OPEN; i++) {
+        if (events[i].id && (0 == events[i].t[LV_LATENCY_INVALIDATE])) {
+            events[i].t[LV_LATENCY_INVALIDATE] = now;
+        }
+    }
+}
+
+/* Panel transfer of the rendered frame done, close its events */
+static void latency_flush_done(int64_t now)
+{
+    for (int i = 0; i < LATENCY_OPEN; i++) {
+        if (events[i].id && events[i].t[LV_LATENCY_RENDER]) {
+            events[i].t[LV_LATENCY_FLUSH] = now;
+            latency_event_close(&events[i], flush_pending_model_us);
+        }
+    }
+    flush_pending = false;
+    lv_timer_pause(flush_poll_timer);
+}
+
+static void latency_flush_poll_cb(lv_timer_t *timer)
+{
+    if (flush_pending && !trace_disp->driver->draw_buf->flushing) {
+        latency_flush_done(esp_timer_get_time());
+    }
+}
+
+static void latency_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    /* LVGL only flushes again once the panel took the previous area */
+    if (flush_pending) {
+        latency_flush_done(esp_timer_get_time());
+    }
+
+    flush_last_us = esp_timer_get_time();
+    flush_last_px = lv_area_get_size(area);
+    disp_flush_ori(disp_drv, area, color_p);
+}
+
+static void latency_monitor(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px)
+{
+    bool drawn = false;
+
+    for (int i = 0; i < LATENCY_OPEN; i++) {
+        int64_t inv = events[i].t[LV_LATENCY_INVALIDATE];
+        if (events[i].id && inv && (flush_last_us > inv)) {
+            events[i].t[LV_LATENCY_RENDER] = flush_last_us;
+            drawn = true;
+        }
+    }
+
+    if (drawn) {
+        flush_pending_model_us = (uint64_t)flush_last_px * sizeof(lv_color_t) * 8 * 1000000ULL / LV_FRAME_MONITOR_SPI_HZ;
+        /* The last area may still be on its way to the panel, flush_ready clears this from the ISR */
+        if (disp_drv->draw_buf->flushing) {
+            flush_pending = true;
+            lv_timer_reset(flush_poll_timer);
+            lv_timer_resume(flush_poll_timer);
+        } else {
+            latency_flush_done(esp_timer_get_time());
+        }
+    }
+    flush_last_us = 0;
+
+    if (disp_monitor_ori) {
+        disp_monitor_ori(disp_drv, time, px);
+    }
+}
+
+void lv_latency_trace_key(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t edge;
+
+    portENTER_CRITICAL(&edge_lock);
+    edge = edge_us;
+    edge_us = 0;
+    portEXIT_CRITICAL(&edge_lock);
+
+    /* Without the encoder pins, or edges left from a turn LVGL ignored, the key is the start */
+    if ((0 == edge) || (now - edge > LV_LATENCY_TIMEOUT_MS * 1000)) {
+        edge = now;
+    }
+
+    latency_expire(now);
+    for (int i = 0; i < LATENCY_OPEN; i++) {
+        if (0 == events[i].id) {
+            memset(&events[i], 0, sizeof(latency_event_t));
+            if (0 == ++event_id) {
+                event_id = 1;
+            }
+            events[i].id = event_id;
+            events[i].screen = latency_screen_index();
+            events[i].t[LV_LATENCY_EDGE] = edge;
+            events[i].t[LV_LATENCY_KEY] = now;
+            return;
+        }
+    }
+}
+
+static int latency_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+void lv_latency_trace_report(void)
+{
+    uint32_t sorted[LV_LATENCY_SAMPLES];
+
+    bsp_display_lock(0);
+    for (int i = 0; i < LV_LATENCY_SCREENS; i++) {
+        latency_screen_t *screen = &screens[i];
+        if (NULL == screen->name) {
+            break;
+        }
+
+        uint32_t num = LV_MIN(screen->count, LV_LATENCY_SAMPLES);
+        printf("%s: %u turns, %u without redraw, last %u in us\n",
+               screen->name, screen->count, screen->no_redraw, num);
+        if (0 == num) {
+            continue;
+        }
+        printf("  %-18s %8s %8s %8s %8s\n", "", "p50", "p90", "p99", "max");
+        for (int c = 0; c < COL_NUM; c++) {
+            for (int n = 0; n < num; n++) {
+                sorted[n] = screen->us[n][c];
+            }
+            qsort(sorted, num, sizeof(uint32_t), latency_cmp);
+            printf("  %-18s %8u %8u %8u %8u\n", col_name[c],
+                   sorted[num * 50 / 100], sorted[num * 90 / 100], sorted[num * 99 / 100], sorted[num - 1]);
+        }
+    }
+    bsp_display_unlock();
+}
+
+void lv_latency_trace_reset(void)
+{
+    bsp_display_lock(0);
+    memset(screens, 0, sizeof(screens));
+    memset(events, 0, sizeof(events));
+    flush_pending = false;
+    bsp_display_unlock();
+}
+
+static int latency_cmd(int argc, char **argv)
+{
+    if ((argc > 1) && (0 == strcmp(argv[1], "reset"))) {
+        lv_latency_trace_reset();
+    } else {
+        lv_latency_trace_report();
+    }
+    return 0;
+}
+
+esp_err_t lv_latency_trace_register_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "latency",
+        .help = "Knob to panel latency percentiles per screen, \"latency reset\" clears them",
+        .hint = "[reset]",
+        .func = &latency_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+
+void lv_latency_trace_init(lv_disp_t *disp)
+{
+    if (trace_disp) {
+        return;
+    }
+
+    trace_disp = disp;
+    flush_poll_timer = lv_timer_create(latency_flush_poll_cb, LATENCY_FLUSH_POLL_MS, NULL);
+    lv_timer_pause(flush_poll_timer);
+    disp_flush_ori = disp->driver->flush_cb;
+    disp_monitor_ori = disp->driver->monitor_cb;
+    disp_rounder_ori = disp->driver->rounder_cb;
+    disp->driver->flush_cb = latency_flush;
+    disp->driver->monitor_cb = latency_monitor;
+    disp->driver->rounder_cb = latency_rounder;
+
+#ifdef BSP_ENCODER_A
+    /* The knob driver polls the pins, an edge interrupt next to it only timestamps */
+    esp_err_t ret = gpio_install_isr_service(0);
+    if ((ESP_OK == ret) || (ESP_ERR_INVALID_STATE == ret)) {
+        const gpio_num_t pins[] = {BSP_ENCODER_A, BSP_ENCODER_B};
+        for (int i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+            gpio_set_intr_type(pins[i], GPIO_INTR_ANYEDGE);
+            gpio_isr_handler_add(pins[i], latency_edge_isr, NULL);
+            gpio_intr_enable(pins[i]);
+        }
+    } else {
+        ESP_LOGW(TAG, "no edge interrupt, latencies start at the key");
+    }
+#endif
+    ESP_LOGI(TAG, "Tracing display %p", disp);
+}
+
+#else
+
+void lv_latency_trace_init(lv_disp_t *disp)
+{
+}
+
+void lv_latency_trace_key(void)
+{
+}
+
+void lv_latency_trace_report(void)
+{
+}
+
+void lv_latency_trace_reset(void)
+{
+}
+
+esp_err_t lv_latency_trace_register_cmd(void)
+{
+    return ESP_OK;
+}
+
+#endif
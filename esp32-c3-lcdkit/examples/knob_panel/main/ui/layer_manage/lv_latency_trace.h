@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set to 1 to time every knob turn from the encoder edge to the pixels flushed to the panel */
+#ifndef LV_LATENCY_TRACE
+#define LV_LATENCY_TRACE            0
+#endif
+
+/* Latencies kept per screen for the percentiles, the oldest are overwritten */
+#define LV_LATENCY_SAMPLES          32
+#define LV_LATENCY_SCREENS          8
+
+/* A turn which did not redraw anything within this time is counted as such and dropped */
+#define LV_LATENCY_TIMEOUT_MS       500
+
+typedef enum {
+    LV_LATENCY_EDGE,            /*!< First encoder edge, GPIO interrupt */
+    LV_LATENCY_KEY,             /*!< LV_EVENT_KEY sent to the focused object */
+    LV_LATENCY_INVALIDATE,      /*!< First area invalidated after the key */
+    LV_LATENCY_RENDER,          /*!< Last area of the frame rendered and handed to the panel */
+    LV_LATENCY_FLUSH,           /*!< Panel transfer of the frame done */
+    LV_LATENCY_STAGE_NUM,
+} lv_latency_stage_t;
+
+/**
+ * @brief Hook the display driver and the encoder pins
+ *
+ * Must be called before lv_create_clock(), otherwise the timer closing frames still being
+ * transferred is deleted by the first layer switch.
+ *
+ * @param disp Display which frames are timed
+ */
+void lv_latency_trace_init(lv_disp_t *disp);
+
+/**
+ * @brief Open an event for a key about to be sent by the encoder, called by lv_encoder_input
+ */
+void lv_latency_trace_key(void);
+
+/**
+ * @brief Print the latency percentiles of every screen
+ */
+void lv_latency_trace_report(void);
+
+void lv_latency_trace_reset(void);
+
+/**
+ * @brief Register the "latency" console command
+ */
+esp_err_t lv_latency_trace_register_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
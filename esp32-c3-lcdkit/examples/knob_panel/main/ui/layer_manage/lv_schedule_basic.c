@@ -4,11 +4,15 @@
  * SPDX-License-Identifier: CC0-1.0
  */
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_check.h"
 #include "esp_err.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 
 #include "lv_schedule_basic.h"
+#include "lv_draw_profiler.h"
 
 static const char *TAG = "lvgl_basic";
 
@@ -28,6 +32,57 @@ static time_out_count time_enter_clock = {
 
 extern void memory_monitor();
 
+#if LV_LAYER_LEAK_CHECK
+#define LEAK_CHECK_LAYERS   16
+
+typedef struct {
+    lv_layer_t *layer;
+    uint32_t visits;
+    UBaseType_t tasks;
+    size_t heap_free;
+    size_t lv_mem_free;
+} leak_check_t;
+
+static leak_check_t leak_checks[LEAK_CHECK_LAYERS];
+
+/* The first visit of a layer is the baseline, the following ones must come back to it */
+static void lv_layer_leak_check(lv_layer_t *layer)
+{
+    leak_check_t *check = NULL;
+    lv_mem_monitor_t mon;
+
+    for (int i = 0; (i < LEAK_CHECK_LAYERS) && !check; i++) {
+        if ((leak_checks[i].layer == layer) || (NULL == leak_checks[i].layer)) {
+            check = &leak_checks[i];
+        }
+    }
+    if (NULL == check) {
+        return;
+    }
+
+    lv_mem_monitor(&mon);
+    UBaseType_t tasks = uxTaskGetNumberOfTasks();
+    size_t heap_free = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+
+    if (0 == check->visits++) {
+        check->layer = layer;
+        check->tasks = tasks;
+        check->heap_free = heap_free;
+        check->lv_mem_free = mon.free_size;
+        return;
+    }
+
+    int heap_delta = (int)check->heap_free - (int)heap_free;
+    int lv_mem_delta = (int)check->lv_mem_free - (int)mon.free_size;
+    if (tasks > check->tasks) {
+        ESP_LOGW(TAG, "%s visit %d: %d tasks, %d more than on the first visit", layer->lv_obj_name, check->visits,
+                 tasks, tasks - check->tasks);
+    }
+    ESP_LOGI(TAG, "%s visit %d: %d tasks, heap %+d bytes, lv_mem %+d bytes since the first visit",
+             layer->lv_obj_name, check->visits, tasks, -heap_delta, -lv_mem_delta);
+}
+#endif
+
 bool is_time_out(time_out_count *tm)
 {
     int32_t isTmOut;
@@ -87,6 +142,7 @@ void lv_func_goto_layer(lv_layer_t *dst_layer)
     lv_layer_t *src_layer = current_layer;
 
     if (src_layer) {
+        lv_draw_profiler_report();
 
         if (src_layer->lv_obj_layer) {
 
@@ -135,11 +191,20 @@ void lv_func_goto_layer(lv_layer_t *dst_layer)
             LV_LOG_INFO("%s != NULL", dst_layer->lv_obj_name);
         }
         current_layer = dst_layer;
+        lv_draw_profiler_attach_layer(dst_layer);
+#if LV_LAYER_LEAK_CHECK
+        lv_layer_leak_check(dst_layer);
+#endif
     }
 
     lv_timer_enable(true);
 }
 
+lv_layer_t *lv_func_get_current_layer(void)
+{
+    return current_layer;
+}
+
 /*
  * once only
  */
@@ -20,6 +20,12 @@ extern "C" {
  *      DEFINES
  *********************/
 
+/* Set to 1 to log the task count and free heap each time a layer is entered and warn when they
+ * grew since its first visit, e.g. tasks or buffers a layer creates but never releases */
+#ifndef LV_LAYER_LEAK_CHECK
+#define LV_LAYER_LEAK_CHECK     0
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -72,4 +78,6 @@ extern void lv_create_clock(lv_layer_t *clock_layer, uint32_t tmOut);
 
 extern void lv_func_goto_layer(lv_layer_t *dst_layer);
 
+extern lv_layer_t *lv_func_get_current_layer(void);
+
 #endif /*LV_EXAMPLE_FUNC_H*/
@@ -0,0 +1,278 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "lv_static_backing.h"
+
+static const char *TAG = "static_backing";
+
+#define BACKING_MAX_STRIPS  8
+
+/* Marks dynamic children hidden only while the backing is rendered */
+#define BACKING_HIDDEN_FLAG LV_OBJ_FLAG_USER_2
+
+/* Own decoration of the root which is drawn from the backing instead */
+static const lv_style_prop_t backing_root_props[] = {
+    LV_STYLE_BG_OPA,
+    LV_STYLE_BG_IMG_OPA,
+    LV_STYLE_BORDER_OPA,
+    LV_STYLE_OUTLINE_OPA,
+    LV_STYLE_SHADOW_OPA,
+};
+
+#define BACKING_ROOT_PROP_NUM   (sizeof(backing_root_props) / sizeof(backing_root_props[0]))
+
+typedef struct {
+    lv_obj_t *root;
+    lv_area_t area;
+    uint8_t strip_num;
+    lv_color_t *strip_buf[BACKING_MAX_STRIPS];
+    lv_img_dsc_t strip_dsc[BACKING_MAX_STRIPS];
+    lv_obj_t *strip_img[BACKING_MAX_STRIPS];
+    bool prop_is_local[BACKING_ROOT_PROP_NUM];
+    lv_style_value_t prop_value[BACKING_ROOT_PROP_NUM];
+} static_backing_t;
+
+static static_backing_t backings[LV_STATIC_BACKING_MAX_ROOTS];
+
+static static_backing_t *backing_find(const lv_obj_t *root)
+{
+    for (int i = 0; i < LV_STATIC_BACKING_MAX_ROOTS; i++) {
+        if (root == backings[i].root) {
+            return &backings[i];
+        }
+    }
+    return NULL;
+}
+
+static bool backing_is_strip(static_backing_t *backing, const lv_obj_t *obj)
+{
+    for (int i = 0; i < backing->strip_num; i++) {
+        if (obj == backing->strip_img[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void backing_free(static_backing_t *backing)
+{
+    for (int i = 0; i < backing->strip_num; i++) {
+        lv_img_cache_invalidate_src(&backing->strip_dsc[i]);
+        heap_caps_free(backing->strip_buf[i]);
+    }
+    memset(backing, 0, sizeof(static_backing_t));
+}
+
+static void backing_root_delete_cb(lv_event_t *e)
+{
+    static_backing_t *backing = backing_find(lv_event_get_target(e));
+    if (backing) {
+        backing_free(backing);
+    }
+}
+
+/* Color showing through outside of a rounded root */
+static lv_color_t backing_get_base_color(lv_obj_t *root)
+{
+    lv_obj_t *parent = lv_obj_get_parent(root);
+
+    while (parent) {
+        if (lv_obj_get_style_bg_opa(parent, LV_PART_MAIN) >= LV_OPA_MAX) {
+            return lv_obj_get_style_bg_color(parent, LV_PART_MAIN);
+        }
+        parent = lv_obj_get_parent(parent);
+    }
+    return lv_color_black();
+}
+
+/* Show only what gets baked: the root decoration and the flagged children */
+static void backing_set_baking(static_backing_t *backing, bool baking)
+{
+    lv_obj_t *root = backing->root;
+
+    for (int i = 0; i < BACKING_ROOT_PROP_NUM; i++) {
+        if (baking) {
+            if (backing->prop_is_local[i]) {
+                lv_obj_set_local_style_prop(root, backing_root_props[i], backing->prop_value[i], LV_PART_MAIN);
+            } else {
+                lv_obj_remove_local_style_prop(root, backing_root_props[i], LV_PART_MAIN);
+            }
+        } else {
+            lv_style_value_t transp = {.num = LV_OPA_TRANSP};
+            lv_obj_set_local_style_prop(root, backing_root_props[i], transp, LV_PART_MAIN);
+        }
+    }
+
+    uint32_t child_cnt = lv_obj_get_child_cnt(root);
+    for (uint32_t i = 0; i < child_cnt; i++) {
+        lv_obj_t *child = lv_obj_get_child(root, i);
+        bool show;
+        if (backing_is_strip(backing, child)) {
+            show = !baking;
+        } else if (lv_obj_has_flag(child, LV_STATIC_BACKING_FLAG)) {
+            show = baking;
+        } else {
+            /* Dynamic children keep their own visibility outside of baking */
+            if (baking && !lv_obj_has_flag(child, LV_OBJ_FLAG_HIDDEN)) {
+                lv_obj_add_flag(child, LV_OBJ_FLAG_HIDDEN | BACKING_HIDDEN_FLAG);
+            } else if (!baking && lv_obj_has_flag(child, BACKING_HIDDEN_FLAG)) {
+                lv_obj_clear_flag(child, LV_OBJ_FLAG_HIDDEN | BACKING_HIDDEN_FLAG);
+            }
+            continue;
+        }
+
+        if (show) {
+            lv_obj_clear_flag(child, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(child, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+}
+
+/* Same as lv_snapshot_take_to_buf() but limited to one strip of the root */
+static void backing_render_strip(static_backing_t *backing, int index)
+{
+    lv_obj_t *root = backing->root;
+    lv_disp_t *obj_disp = lv_obj_get_disp(root);
+    lv_img_dsc_t *dsc = &backing->strip_dsc[index];
+
+    lv_area_t strip_area = backing->area;
+    strip_area.y1 = backing->area.y1 + index * LV_STATIC_BACKING_STRIP_H;
+    strip_area.y2 = strip_area.y1 + dsc->header.h - 1;
+
+    lv_color_fill(backing->strip_buf[index], backing_get_base_color(root), dsc->header.w * dsc->header.h);
+
+    lv_disp_drv_t driver;
+    lv_disp_drv_init(&driver);
+    driver.hor_res = lv_disp_get_hor_res(obj_disp);
+    driver.ver_res = lv_disp_get_ver_res(obj_disp);
+    lv_disp_drv_use_generic_set_px_cb(&driver, LV_IMG_CF_TRUE_COLOR);
+
+    lv_disp_t fake_disp;
+    lv_memset_00(&fake_disp, sizeof(lv_disp_t));
+    fake_disp.driver = &driver;
+
+    lv_draw_ctx_t *draw_ctx = lv_mem_alloc(obj_disp->driver->draw_ctx_size);
+    LV_ASSERT_MALLOC(draw_ctx);
+    if (NULL == draw_ctx) {
+        return;
+    }
+    obj_disp->driver->draw_ctx_init(fake_disp.driver, draw_ctx);
+    draw_ctx->clip_area = &strip_area;
+    draw_ctx->buf_area = &strip_area;
+    draw_ctx->buf = (void *)backing->strip_buf[index];
+    driver.draw_ctx = draw_ctx;
+
+    lv_disp_t *refr_ori = _lv_refr_get_disp_refreshing();
+    _lv_refr_set_disp_refreshing(&fake_disp);
+
+    lv_obj_redraw(draw_ctx, root);
+
+    _lv_refr_set_disp_refreshing(refr_ori);
+    obj_disp->driver->draw_ctx_deinit(fake_disp.driver, draw_ctx);
+    lv_mem_free(draw_ctx);
+}
+
+static void backing_render(static_backing_t *backing)
+{
+    lv_obj_update_layout(backing->root);
+
+    backing_set_baking(backing, true);
+    for (int i = 0; i < backing->strip_num; i++) {
+        backing_render_strip(backing, i);
+    }
+    backing_set_baking(backing, false);
+
+    for (int i = 0; i < backing->strip_num; i++) {
+        lv_obj_invalidate(backing->strip_img[i]);
+    }
+}
+
+bool lv_static_backing_create(lv_obj_t *root)
+{
+    static_backing_t *backing = backing_find(root);
+    if (backing) {
+        lv_static_backing_invalidate(root);
+        return true;
+    }
+
+    backing = backing_find(NULL);
+    if (NULL == backing) {
+        ESP_LOGW(TAG, "no free slot");
+        return false;
+    }
+
+    lv_obj_update_layout(root);
+    lv_obj_get_coords(root, &backing->area);
+    lv_coord_t w = lv_area_get_width(&backing->area);
+    lv_coord_t h = lv_area_get_height(&backing->area);
+    uint8_t strip_num = (h + LV_STATIC_BACKING_STRIP_H - 1) / LV_STATIC_BACKING_STRIP_H;
+    if (strip_num > BACKING_MAX_STRIPS) {
+        ESP_LOGW(TAG, "root too high: %d", h);
+        memset(backing, 0, sizeof(static_backing_t));
+        return false;
+    }
+
+    backing->root = root;
+    for (int i = 0; i < strip_num; i++) {
+        lv_coord_t strip_h = LV_MIN(LV_STATIC_BACKING_STRIP_H, h - i * LV_STATIC_BACKING_STRIP_H);
+        uint32_t size = w * strip_h * sizeof(lv_color_t);
+        backing->strip_buf[i] = heap_caps_malloc(size, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+        if (NULL == backing->strip_buf[i]) {
+            ESP_LOGW(TAG, "no mem for strip %d (%u bytes), draw %p directly", i, size, root);
+            backing_free(backing);
+            return false;
+        }
+        backing->strip_num++;
+
+        lv_img_dsc_t *dsc = &backing->strip_dsc[i];
+        dsc->header.cf = LV_IMG_CF_TRUE_COLOR;
+        dsc->header.always_zero = 0;
+        dsc->header.w = w;
+        dsc->header.h = strip_h;
+        dsc->data_size = size;
+        dsc->data = (const uint8_t *)backing->strip_buf[i];
+    }
+
+    for (int i = 0; i < BACKING_ROOT_PROP_NUM; i++) {
+        backing->prop_is_local[i] = (LV_RES_OK == lv_obj_get_local_style_prop(root, backing_root_props[i],
+                                     &backing->prop_value[i], LV_PART_MAIN));
+    }
+
+    for (int i = 0; i < backing->strip_num; i++) {
+        lv_obj_t *img = lv_img_create(root);
+        lv_img_set_src(img, &backing->strip_dsc[i]);
+        lv_obj_add_flag(img, LV_OBJ_FLAG_IGNORE_LAYOUT | LV_OBJ_FLAG_FLOATING);
+        lv_obj_clear_flag(img, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_move_to_index(img, i);
+
+        /* Child positions are relative to the content area, align to the root coordinates */
+        lv_area_t img_area;
+        lv_obj_set_pos(img, 0, 0);
+        lv_obj_update_layout(img);
+        lv_obj_get_coords(img, &img_area);
+        lv_obj_set_pos(img, backing->area.x1 - img_area.x1,
+                       backing->area.y1 + i * LV_STATIC_BACKING_STRIP_H - img_area.y1);
+        backing->strip_img[i] = img;
+    }
+    lv_obj_add_event_cb(root, backing_root_delete_cb, LV_EVENT_DELETE, NULL);
+
+    backing_render(backing);
+    ESP_LOGI(TAG, "%p cached in %d strips of %dx%d", root, backing->strip_num, w, LV_STATIC_BACKING_STRIP_H);
+    return true;
+}
+
+void lv_static_backing_invalidate(lv_obj_t *root)
+{
+    static_backing_t *backing = backing_find(root);
+    if (backing) {
+        backing_render(backing);
+    }
+}
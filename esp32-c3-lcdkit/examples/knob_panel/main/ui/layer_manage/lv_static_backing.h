@@ -0,0 +1,48 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Children carrying this flag are baked into the backing of their parent */
+#define LV_STATIC_BACKING_FLAG          LV_OBJ_FLAG_USER_1
+
+/* Height of one cached strip, the backing is split to fit a fragmented heap */
+#define LV_STATIC_BACKING_STRIP_H       40
+
+#define LV_STATIC_BACKING_MAX_ROOTS     2
+
+/**
+ * @brief Render the background of `root` once and blit the cached copy on later redraws
+ *
+ * The own background, border, outline and shadow of `root` plus every direct child
+ * flagged with LV_STATIC_BACKING_FLAG are rendered into RGB565 strips. The strips are
+ * inserted as the bottom-most children of `root` and the baked objects are hidden.
+ *
+ * @note Nothing baked into the backing is redrawn until lv_static_backing_invalidate()
+ *       is called, so call it after changing any style or source of a baked object.
+ *
+ * @param root Object whose decoration never changes
+ * @return
+ *      - true  The backing is in use
+ *      - false Out of memory or no free slot, `root` is drawn as before
+ */
+bool lv_static_backing_create(lv_obj_t *root);
+
+/**
+ * @brief Render the backing of `root` again after its baked content changed
+ */
+void lv_static_backing_invalidate(lv_obj_t *root);
+
+#ifdef __cplusplus
+}
+#endif
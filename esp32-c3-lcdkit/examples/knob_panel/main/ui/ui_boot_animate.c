@@ -69,7 +69,7 @@ static void anim_timer_handle(lv_obj_t *parent)
         sys_param_t *param = settings_get_parameter();
         if (param->need_hint) {
             param->need_hint = 0;
-            settings_write_parameter_to_nvs();
+            settings_save();
             lv_func_goto_layer(&language_Layer);
         } else {
             lv_func_goto_layer(&menu_layer);
@@ -10,6 +10,8 @@
 
 #include "settings.h"
 #include "app_audio.h"
+#include "app_event_ring.h"
+#include "app_prompt_queue.h"
 #include "ir_nec_test.h"
 
 #include "lv_example_pub.h"
@@ -67,7 +69,6 @@ static lv_obj_t *page;
 static lv_obj_t *label_EN, *label_CN;
 static lv_obj_t *imgbtn_TEST_FAILED, *imgbtn_TEST_OK;
 
-static time_out_count time_500ms;
 static factory_step_t factory_test_step = FACTORY_STEP_MAX;
 static uint8_t factory_sub_step;
 
@@ -359,9 +360,9 @@ static void lv_create_test_Sound(lv_obj_t *factory_bg, uint8_t event)
         lv_obj_align(label_guide, LV_ALIGN_CENTER, 0, -20);
         lv_label_set_text(label_guide, "喇叭正常?");
 
-        audio_handle_info(SOUND_TYPE_FACTORY);
+        prompt_queue_post(SOUND_TYPE_FACTORY, PROMPT_PRIO_NORMAL, PROMPT_KEY_FACTORY_SOUND);
     } else {
-        audio_handle_info(SOUND_TYPE_FACTORY);
+        prompt_queue_post(SOUND_TYPE_FACTORY, PROMPT_PRIO_NORMAL, PROMPT_KEY_FACTORY_SOUND);
     }
 
     switch (factory_sub_step) {
@@ -466,9 +467,7 @@ static void lv_create_test_IR(lv_obj_t *factory_bg, uint8_t event)
             ESP_LOGI(TAG, "FACTORY_STEP_IR++:%d", focused);
             factory_test_step_goto(focused);
         } else if (0xFE == event) {
-            if (nec_test_result()) {
-                lv_label_set_text(label_guide, "成功\n按下结束");
-            }
+            lv_label_set_text(label_guide, "成功\n按下结束");
         }
     }
 }
@@ -512,6 +511,16 @@ static void lv_create_test_Result(lv_obj_t *factory_bg, uint8_t event)
     }
 }
 
+static void factory_ir_event_cb(const app_event_t *event)
+{
+    if (FACTORY_STEP_IR == factory_test_step) {
+        lv_obj_t *parent = sprite_test_list[FACTORY_STEP_IR].sprite_parent;
+        if (sprite_test_list[FACTORY_STEP_IR].sprite_event_detect) {
+            sprite_test_list[FACTORY_STEP_IR].sprite_event_detect(parent, 0xFE);
+        }
+    }
+}
+
 static void factory_event_cb(lv_event_t *e)
 {
     lv_event_code_t code = lv_event_get_code(e);
@@ -530,10 +539,9 @@ static void factory_event_cb(lv_event_t *e)
             key = LV_KEY_DOWN;
         }
 
-        if (is_time_out(&time_500ms)) {
-            if (sprite_test_list[focus].sprite_event_detect) {
-                sprite_test_list[focus].sprite_event_detect(parent, key);
-            }
+        /* The test steps only look at the direction, a coalesced read is one key */
+        if (sprite_test_list[focus].sprite_event_detect) {
+            sprite_test_list[focus].sprite_event_detect(parent, key);
         }
     } else if (LV_EVENT_LONG_PRESSED == code) {
     }
@@ -553,7 +561,6 @@ static bool factory_Layer_enter_cb(void *layer)
         lv_obj_set_size(create_layer->lv_obj_layer, LV_HOR_RES, LV_VER_RES);
 
         factory_test_step_goto(FACTORY_STEP_ENCODE);
-        set_time_out(&time_500ms, 100);
     }
 
     ui_remove_all_objs_from_encoder_group();//roll will add event default.
@@ -562,6 +569,7 @@ static bool factory_Layer_enter_cb(void *layer)
     lv_obj_add_event_cb(create_layer->lv_obj_layer, factory_event_cb, LV_EVENT_KEY, NULL);
     lv_obj_add_event_cb(create_layer->lv_obj_layer, factory_event_cb, LV_EVENT_LONG_PRESSED, NULL);
     ui_add_obj_to_encoder_group(create_layer->lv_obj_layer);
+    app_event_subscribe(APP_EVENT_IR_TEST_OK, factory_ir_event_cb);
 
     return ret;
 }
@@ -569,17 +577,11 @@ static bool factory_Layer_enter_cb(void *layer)
 static bool factory_Layer_exit_cb(void *layer)
 {
     LV_LOG_USER("");
+    app_event_subscribe(APP_EVENT_IR_TEST_OK, NULL);
     return true;
 }
 
 static void factory_Layer_timer_cb(lv_timer_t *tmr)
 {
     feed_clock_time();
-
-    if (FACTORY_STEP_IR == factory_test_step) {
-        lv_obj_t *parent = sprite_test_list[FACTORY_STEP_IR].sprite_parent;
-        if (sprite_test_list[FACTORY_STEP_IR].sprite_event_detect) {
-            sprite_test_list[FACTORY_STEP_IR].sprite_event_detect(parent, 0xFE);
-        }
-    }
 }
@@ -11,13 +11,13 @@
 #include "settings.h"
 #include "lv_example_pub.h"
 #include "lv_example_image.h"
+#include "lv_encoder_input.h"
+#include "lv_static_backing.h"
 
 static lv_obj_t *page;
 static lv_obj_t *label_EN, *label_CN;
 static lv_obj_t *imgbtn_lang_CN, *imgbtn_lang_EN;
 
-static time_out_count time_500ms;
-
 static bool language_Layer_enter_cb(void *layer);
 static bool language_Layer_exit_cb(void *layer);
 static void language_Layer_timer_cb(lv_timer_t *tmr);
@@ -40,8 +40,8 @@ static void language_event_cb(lv_event_t *e)
     if (LV_EVENT_FOCUSED == code) {
         lv_group_set_editing(lv_group_get_default(), true);
     } else if (LV_EVENT_KEY == code) {
-
-        if (is_time_out(&time_500ms)) {
+        /* Two languages, an even number of detents ends on the same one */
+        if (lv_encoder_input_get_steps(e) & 1) {
             if (lv_obj_has_state(imgbtn_lang_EN, LV_STATE_CHECKED) == false) {
                 lv_img_set_src(imgbtn_lang_EN, &language_select);
                 lv_obj_add_state(imgbtn_lang_EN, LV_STATE_CHECKED);
@@ -66,7 +66,7 @@ static void language_event_cb(lv_event_t *e)
         lv_indev_wait_release(lv_indev_get_next(NULL));
         ui_remove_all_objs_from_encoder_group();
         lv_func_goto_layer(&menu_layer);
-        settings_write_parameter_to_nvs();
+        settings_save();
     }
 }
 
@@ -83,16 +83,19 @@ void ui_language_init(lv_obj_t *parent)
     lv_obj_t *img_language_bg = lv_img_create(page);
     lv_img_set_src(img_language_bg, &language_bg_dither);
     lv_obj_align(img_language_bg, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_add_flag(img_language_bg, LV_STATIC_BACKING_FLAG);
 
     lv_obj_t *labelinfo_top = lv_label_create(page);
     lv_obj_set_style_text_font(labelinfo_top, &HelveticaNeue_Regular_24, 0);
     lv_label_set_text(labelinfo_top, "Please select a");
     lv_obj_align(labelinfo_top, LV_ALIGN_TOP_MID, 0, 40);
+    lv_obj_add_flag(labelinfo_top, LV_STATIC_BACKING_FLAG);
 
     lv_obj_t *labelinfo_bottom = lv_label_create(page);
     lv_obj_set_style_text_font(labelinfo_bottom, &HelveticaNeue_Regular_24, 0);
     lv_label_set_text(labelinfo_bottom, "language");
     lv_obj_align(labelinfo_bottom, LV_ALIGN_TOP_MID, 0, 70);
+    lv_obj_add_flag(labelinfo_bottom, LV_STATIC_BACKING_FLAG);
 
     imgbtn_lang_EN = lv_img_create(page);
     lv_obj_align(imgbtn_lang_EN, LV_ALIGN_CENTER, -40, 50);
@@ -123,6 +126,8 @@ void ui_language_init(lv_obj_t *parent)
     lv_obj_add_event_cb(page, language_event_cb, LV_EVENT_KEY, NULL);
     lv_obj_add_event_cb(page, language_event_cb, LV_EVENT_LONG_PRESSED, NULL);
     ui_add_obj_to_encoder_group(page);
+
+    lv_static_backing_create(page);
 }
 
 static bool language_Layer_enter_cb(void *layer)
@@ -138,7 +143,6 @@ static bool language_Layer_enter_cb(void *layer)
         lv_obj_set_size(create_layer->lv_obj_layer, LV_HOR_RES, LV_VER_RES);
 
         ui_language_init(create_layer->lv_obj_layer);
-        set_time_out(&time_500ms, 100);
     }
     sys_param_t *param = settings_get_parameter();
     param->language = LANGUAGE_EN;
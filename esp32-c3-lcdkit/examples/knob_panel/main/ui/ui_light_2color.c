@@ -6,36 +6,23 @@
 
 #include "lvgl.h"
 #include <stdio.h>
+#include <sys/param.h>
 
 #include "lv_example_pub.h"
 #include "lv_example_image.h"
+#include "lv_encoder_input.h"
 #include "bsp/esp-bsp.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
-#include "app_audio.h"
-#include "freertos/event_groups.h"
-
-static EventGroupHandle_t announcement_event_group;
-
-// Define bit masks for each announcement type
-#define ANNOUNCE_PWM_100_BIT (1 << 0)
-#define ANNOUNCE_PWM_75_BIT (1 << 1)
-#define ANNOUNCE_PWM_50_BIT (1 << 2)
-#define ANNOUNCE_PWM_25_BIT (1 << 3)
-#define ANNOUNCE_LIGHT_OFF_BIT (1 << 4)
-#define ANNOUNCE_TIMER_COMPLETE_BIT (1 << 5)
-#define ANNOUNCE_COLOR_WARM_BIT (1 << 6)
-#define ANNOUNCE_COLOR_COOL_BIT (1 << 7)
-
-#define ALL_ANNOUNCEMENT_BITS (ANNOUNCE_PWM_100_BIT | ANNOUNCE_PWM_75_BIT |           \
-                               ANNOUNCE_PWM_50_BIT | ANNOUNCE_PWM_25_BIT |            \
-                               ANNOUNCE_LIGHT_OFF_BIT | ANNOUNCE_TIMER_COMPLETE_BIT | \
-                               ANNOUNCE_COLOR_WARM_BIT | ANNOUNCE_COLOR_COOL_BIT)
+#include "app_led_fx.h"
+#include "app_light_model.h"
+#include "app_prompt_queue.h"
+#include "app_state.h"
 
 static bool light_2color_layer_enter_cb(void *layer);
 static bool light_2color_layer_exit_cb(void *layer);
 static void light_2color_layer_timer_cb(lv_timer_t *tmr);
+static void light_2color_led_apply(uint16_t fade_ms);
 static lv_obj_t *page_label; // New label for status messages
 typedef enum
 {
@@ -58,25 +45,11 @@ typedef struct
     const lv_img_dsc_t *img_pwm_100[2];
 } ui_light_img_t;
 
-TaskHandle_t xHandle = NULL;
-
-typedef enum
-{
-    ANNOUNCE_LIGHT_ON,
-    ANNOUNCE_LIGHT_OFF,
-    ANNOUNCE_COLOR_WARM,
-    ANNOUNCE_COLOR_COOL,
-    ANNOUNCE_PWM_SET,
-    ANNOUNCE_PWM_100,
-    ANNOUNCE_PWM_75,
-    ANNOUNCE_PWM_50,
-    ANNOUNCE_PWM_25,
-    ANNOUNCE_TIMER_COMPLETE
-} announcement_type_t;
+#define LIGHT_FADE_MS   150
+#define LIGHT_PWM_STEP  1
 
 // Timer Variables
 static int timer_seconds = 180; // 3 minutes in seconds
-static lv_timer_t *countdown_timer_handle = NULL;
 static int countdown_counter = 0; // Counts the number of timer callbacks
 static bool timer_active = false; // Indicates if the timer is active
 
@@ -90,25 +63,17 @@ typedef enum
 } setting_state_t;
 
 static setting_state_t current_setting_state = MODE_NORMAL; // Initial state
-static LIGHT_CCK_TYPE selected_color = LIGHT_CCK_WARM;      // Default color
 static int set_timer_minutes = 0;                           // Timer duration in minutes
 
-
-typedef struct
-{
-    announcement_type_t type;
-    uint8_t pwm_level; // Relevant for PWM announcements
-} announcement_message_t;
-
 static lv_obj_t *page;
 
-static QueueHandle_t announcement_queue = NULL;
-static time_out_count time_20ms, time_500ms;
+static time_out_count time_20ms;
 
 static lv_obj_t *img_light_bg, *label_pwm_set;
 static lv_obj_t *img_light_pwm_25, *img_light_pwm_50, *img_light_pwm_75, *img_light_pwm_100, *img_light_pwm_0;
 
 static light_set_attribute_t light_set_conf, light_xor;
+static uint8_t light_quarter;
 
 static const ui_light_img_t light_image = {
     {&light_warm_bg, &light_cool_bg},
@@ -129,125 +94,41 @@ lv_layer_t light_2color_Layer = {
 };
 
 
-void LED_FLASH_TASK(void *pvParameters)
-{
-    (void)pvParameters; // this is supressing unused param.
-    while (1)
-    {
-        bsp_led_rgb_set(0xFF, 0x00, 0x00); 
-        vTaskDelay(pdMS_TO_TICKS(100));
-        bsp_led_rgb_set(0x00, 0x00, 0xFF);
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-    vTaskDelete(NULL);
-}
-
 
 
 
-static void audio_announcement_task(void *pvParameters)
-{
-    EventBits_t uxBits;
-    while (1)
-    {
-        uxBits = xEventGroupWaitBits(
-            announcement_event_group,
-            ALL_ANNOUNCEMENT_BITS,    
-            pdTRUE,                  
-            pdFALSE,                  
-            portMAX_DELAY             
-        );
-        if (uxBits & ANNOUNCE_PWM_100_BIT)
-        {
-            audio_handle_info(SOUND_TYPE_LIGHT_100);
-        }
-        if (uxBits & ANNOUNCE_PWM_75_BIT)
-        {
-            audio_handle_info(SOUND_TYPE_LIGHT_75);
-        }
-        if (uxBits & ANNOUNCE_PWM_50_BIT)
-        {
-            audio_handle_info(SOUND_TYPE_LIGHT_50);
-        }
-        if (uxBits & ANNOUNCE_PWM_25_BIT)
-        {
-            audio_handle_info(SOUND_TYPE_LIGHT_25);
-        }
-        if (uxBits & ANNOUNCE_LIGHT_OFF_BIT)
-        {
-            audio_handle_info(SOUND_TYPE_LIGHT_OFF);
-        }
-        if (uxBits & ANNOUNCE_COLOR_WARM_BIT)
-        {
-            audio_handle_info(SOUND_TYPE_COLOR_WARM);
-        }
-        if (uxBits & ANNOUNCE_COLOR_COOL_BIT)
-        {
-            audio_handle_info(SOUND_TYPE_COLOR_COOL);
-        }
-        if (uxBits & ANNOUNCE_TIMER_COMPLETE_BIT)
-        {
-            audio_handle_info(SOUND_TYPE_ALARM);
-        }
-        // Add a small delay to prevent tight looping, if necessary
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-}
-
 static void light_2color_event_cb(lv_event_t *e)
 {
     lv_event_code_t code = lv_event_get_code(e);
-    announcement_message_t msg;
 
     if (code == LV_EVENT_FOCUSED) {
         lv_group_set_editing(lv_group_get_default(), true);
     }
     else if (code == LV_EVENT_KEY) {
-        uint32_t key = lv_event_get_key(e);
-
-        if (is_time_out(&time_500ms)) {
-            if (current_setting_state == MODE_NORMAL) {
-                // Brightness Control Mode If branches.
-                if (key == LV_KEY_RIGHT) {
-                    if (light_set_conf.light_pwm < 100) {
-                        light_set_conf.light_pwm += 25;
-                        // Update the UI to reflect the new brightness level
-                        lv_label_set_text_fmt(label_pwm_set, "%d%%", light_set_conf.light_pwm);
-                        msg.type = ANNOUNCE_PWM_SET;
-                        msg.pwm_level = light_set_conf.light_pwm;
-                        xEventGroupSetBits(announcement_event_group, msg.type);
-                    }
-                }
-                else if (key == LV_KEY_LEFT) {
-                    if (light_set_conf.light_pwm > 0) {
-                        light_set_conf.light_pwm -= 25;
-                        lv_label_set_text_fmt(label_pwm_set, "%d%%", light_set_conf.light_pwm);
-                        msg.type = ANNOUNCE_PWM_SET;
-                        msg.pwm_level = light_set_conf.light_pwm;
-                        xEventGroupSetBits(announcement_event_group, msg.type);
-                    }
-                }
+        int32_t steps = lv_encoder_input_get_accel_steps(e);
+
+        if (current_setting_state == MODE_NORMAL) {
+            // Brightness Control Mode, accelerated 1% steps
+            int level = MIN(MAX(light_set_conf.light_pwm + steps * LIGHT_PWM_STEP, 0), LIGHT_LEVEL_MAX);
+            if (level != light_set_conf.light_pwm) {
+                light_set_conf.light_pwm = level;
+                app_state_set(APP_STATE_LIGHT_LEVEL, level);
+                // Update the UI to reflect the new brightness level
+                lv_label_set_text_fmt(label_pwm_set, "%d%%", light_set_conf.light_pwm);
             }
-            else if (current_setting_state == SETTING_TIMER) {
-                // Timer Setting Mode
-                if (key == LV_KEY_RIGHT) {
-                    set_timer_minutes += 1;
-                    if (set_timer_minutes > 60) { 
-                        set_timer_minutes = 60;
-                        lv_label_set_text(page_label, "Max Timer Set");
-                    }
-                    else {
-                        lv_label_set_text_fmt(label_pwm_set, "%02d:%02d", set_timer_minutes, 0);
-                        lv_label_set_text(page_label, "Timer Set: Rotate Knob");
-                    }
-                }
-                else if (key == LV_KEY_LEFT) {
-                    if (set_timer_minutes > 1) { // Prevent timer from going below 1 minute
-                        set_timer_minutes -= 1;
-                        lv_label_set_text_fmt(label_pwm_set, "%02d:%02d", set_timer_minutes, 0);
-                        lv_label_set_text(page_label, "Timer Set: Rotate Knob");
-                    }
-                }
+        }
+        else if (current_setting_state == SETTING_TIMER) {
+            // Timer Setting Mode, 1 to 60 minutes
+            int minutes = set_timer_minutes + steps;
+            if (minutes > 60) {
+                set_timer_minutes = 60;
+                lv_label_set_text_fmt(label_pwm_set, "%02d:%02d", set_timer_minutes, 0);
+                lv_label_set_text(page_label, "Max Timer Set");
+            }
+            else if (minutes >= 1) { // Prevent timer from going below 1 minute
+                set_timer_minutes = minutes;
+                lv_label_set_text_fmt(label_pwm_set, "%02d:%02d", set_timer_minutes, 0);
+                lv_label_set_text(page_label, "Timer Set: Rotate Knob");
             }
         }
     }
@@ -262,6 +143,7 @@ static void light_2color_event_cb(lv_event_t *e)
             if (set_timer_minutes > 0) {
                 timer_seconds = set_timer_minutes * 60;
                 timer_active = true;
+                app_state_set(APP_STATE_LIGHT_TIMER_S, timer_seconds);
                 countdown_counter = 0;
                 lv_label_set_text_fmt(label_pwm_set, "%02d:%02d", timer_seconds / 60, timer_seconds % 60);
                 lv_label_set_text(page_label, "Timer Started");
@@ -274,8 +156,11 @@ static void light_2color_event_cb(lv_event_t *e)
         }
         else if (current_setting_state == TIMER_SET) 
         {
-            vTaskDelete(xHandle);
+            /* Stop the alarm, back to the light color */
+            light_2color_led_apply(0);
             timer_seconds = 0;
+            timer_active = false;
+            app_state_set(APP_STATE_LIGHT_TIMER_S, 0);
             lv_label_set_text_fmt(label_pwm_set, "%02d:%02d", 0, 0);
             lv_label_set_text(page_label, "Timer Ended");
             current_setting_state = MODE_NORMAL;
@@ -294,9 +179,12 @@ void ui_light_2color_init(lv_obj_t *parent)
 {
     light_xor.light_pwm = 0xFF;
     light_xor.light_cck = LIGHT_CCK_MAX;
+    light_quarter = 0xFF;
 
-    light_set_conf.light_pwm = 50;
+    /* Back where the screen was left, also after a reboot */
+    light_set_conf.light_pwm = app_state_get(APP_STATE_LIGHT_LEVEL);
     light_set_conf.light_cck = LIGHT_CCK_WARM;
+    timer_seconds = app_state_get(APP_STATE_LIGHT_TIMER_S);
 
     page = lv_obj_create(parent);
     lv_obj_set_size(page, LV_HOR_RES, LV_VER_RES);
@@ -313,16 +201,18 @@ void ui_light_2color_init(lv_obj_t *parent)
     label_pwm_set = lv_label_create(page);
     lv_obj_set_style_text_font(label_pwm_set, &HelveticaNeue_Regular_24, 0);
 
-    if (light_set_conf.light_pwm)
-    {
-        lv_label_set_text_fmt(label_pwm_set, "%d%%", light_set_conf.light_pwm);
-    }
-    else
+    if (timer_seconds)
     {
         lv_label_set_text_fmt(label_pwm_set, "%02d:%02d", timer_seconds / 60, timer_seconds % 60);
-        // Start the countdown timer
+        // Resume the countdown timer
         timer_active = true;
         countdown_counter = 0;
+        current_setting_state = TIMER_SET;
+    }
+    else
+    {
+        lv_label_set_text_fmt(label_pwm_set, "%d%%", light_set_conf.light_pwm);
+        timer_active = false;
     }
     lv_obj_align(label_pwm_set, LV_ALIGN_CENTER, 0, 65);
 
@@ -376,18 +266,6 @@ static bool light_2color_layer_enter_cb(void *layer)
 
         ui_light_2color_init(create_layer->lv_obj_layer);
         set_time_out(&time_20ms, 20);
-        set_time_out(&time_500ms, 200);
-
-        announcement_event_group = xEventGroupCreate();
-        if (announcement_event_group == NULL)
-        {
-            LV_LOG_ERROR("Failed to create announcement event group");
-        }
-        else
-        {
-            // Create the audio announcement task
-            xTaskCreate(audio_announcement_task, "AudioAnnouncement", 2048, NULL, 5, NULL);
-        }
     }
 
     return ret;
@@ -396,38 +274,33 @@ static bool light_2color_layer_enter_cb(void *layer)
 static bool light_2color_layer_exit_cb(void *layer)
 {
     LV_LOG_USER("");
-    bsp_led_rgb_set(0x00, 0x00, 0x00);
+    led_fx_set(0x00, 0x00, 0x00);
 
-    // Stop the timer if it's active
-    if (timer_active)
-    {
-        timer_active = false;
-        countdown_counter = 0;
-        timer_seconds = 180; // Reset for next use
-
-        // Reset the label to display PWM percentage or a default state
-        if (light_set_conf.light_pwm)
-        {
-            lv_label_set_text_fmt(label_pwm_set, "%d%%", light_set_conf.light_pwm);
-        }
-        else
-        {
-            lv_label_set_text(label_pwm_set, "--");
-        }
-    }
-    // Delete the event group
-    if (announcement_event_group != NULL)
-    {
-        vEventGroupDelete(announcement_event_group);
-        announcement_event_group = NULL;
-    }
+    // A running timer is paused, it resumes when the screen is entered again
+    app_state_set(APP_STATE_LIGHT_TIMER_S, timer_active ? timer_seconds : 0);
+    timer_active = false;
+    countdown_counter = 0;
     return true;
 }
 
+/* Show the applied light setting on the LED */
+static void light_2color_led_apply(uint16_t fade_ms)
+{
+    uint8_t cct = (LIGHT_CCK_COOL == light_xor.light_cck) ? LIGHT_CCT_COOL : LIGHT_CCT_WARM;
+    light_rgb_t rgb = light_model_rgb(light_xor.light_pwm, cct);
+
+    led_fx_fade_to(rgb.r, rgb.g, rgb.b, fade_ms);
+}
+
+/* The images and prompts come in quarters, the level in LIGHT_PWM_STEP */
+static uint8_t light_2color_quarter(uint8_t pwm)
+{
+    return pwm ? MAX(25, (pwm + 12) / 25 * 25) : 0;
+}
+
 // Handles timer callback and light level call back.
 static void light_2color_layer_timer_cb(lv_timer_t *tmr)
 {
-    uint32_t RGB_color = 0xFF;
     feed_clock_time();
 
     if (is_time_out(&time_20ms))
@@ -445,6 +318,10 @@ static void light_2color_layer_timer_cb(lv_timer_t *tmr)
                 if (timer_seconds > 0)
                 {
                     timer_seconds--;
+                    if (0 == timer_seconds % APP_STATE_TIMER_SAVE_S)
+                    {
+                        app_state_set(APP_STATE_LIGHT_TIMER_S, timer_seconds);
+                    }
 
                     int minutes = timer_seconds / 60;
                     int seconds = timer_seconds % 60;
@@ -453,20 +330,8 @@ static void light_2color_layer_timer_cb(lv_timer_t *tmr)
                     if (timer_seconds == 0)
                     {
                         timer_active = false;
-                        if (selected_color == LIGHT_CCK_WARM)
-                        {
-                            // Add task call. AKA a seperate thread init.
-                            xEventGroupSetBits(announcement_event_group, ANNOUNCE_TIMER_COMPLETE_BIT);
-                            xTaskCreate(LED_FLASH_TASK, "LED_FLASH_TASK", 1024, NULL, 5, &xHandle);
-                            
-                        }
-                        else if (selected_color == LIGHT_CCK_COOL)
-                        {
-                            // Add task call
-                            xEventGroupSetBits(announcement_event_group, ANNOUNCE_TIMER_COMPLETE_BIT);
-                            xTaskCreate(LED_FLASH_TASK, "LED_FLASH_TASK", 1024, NULL, 5, &xHandle);
-                        }
-                        
+                        prompt_queue_post(SOUND_TYPE_ALARM, PROMPT_PRIO_HIGH, PROMPT_KEY_NONE);
+                        led_fx_play(&led_fx_alarm);
                     }
                 }
             }
@@ -477,21 +342,7 @@ static void light_2color_layer_timer_cb(lv_timer_t *tmr)
             light_xor.light_pwm = light_set_conf.light_pwm;
             light_xor.light_cck = light_set_conf.light_cck;
 
-            if (LIGHT_CCK_COOL == light_xor.light_cck)
-            {
-                RGB_color = (0xFF * light_xor.light_pwm / 100) << 16 |
-                            (0xFF * light_xor.light_pwm / 100) << 8 |
-                            (0xFF * light_xor.light_pwm / 100) << 0;
-            }
-            else
-            {
-                RGB_color = (0xFF * light_xor.light_pwm / 100) << 16 |
-                            (0xFF * light_xor.light_pwm / 100) << 8 |
-                            (0x33 * light_xor.light_pwm / 100) << 0;
-            }
-            bsp_led_rgb_set((RGB_color >> 16) & 0xFF,
-                            (RGB_color >> 8) & 0xFF,
-                            (RGB_color >> 0) & 0xFF);
+            light_2color_led_apply(LIGHT_FADE_MS);
 
             lv_obj_add_flag(img_light_pwm_100, LV_OBJ_FLAG_HIDDEN);
             lv_obj_add_flag(img_light_pwm_75, LV_OBJ_FLAG_HIDDEN);
@@ -499,43 +350,61 @@ static void light_2color_layer_timer_cb(lv_timer_t *tmr)
             lv_obj_add_flag(img_light_pwm_25, LV_OBJ_FLAG_HIDDEN);
             lv_obj_add_flag(img_light_pwm_0, LV_OBJ_FLAG_HIDDEN);
 
-            if (light_set_conf.light_pwm)
-            {
-                lv_label_set_text_fmt(label_pwm_set, "%d%%", light_set_conf.light_pwm);
-            }
-            else
+            // A resumed timer keeps its countdown on the label
+            if (!timer_active)
             {
-                lv_label_set_text(label_pwm_set, "--");
+                if (light_set_conf.light_pwm)
+                {
+                    lv_label_set_text_fmt(label_pwm_set, "%d%%", light_set_conf.light_pwm);
+                }
+                else
+                {
+                    lv_label_set_text(label_pwm_set, "--");
+                }
             }
 
             uint8_t cck_set = (uint8_t)light_xor.light_cck;
-            announcement_message_t msg;
+            uint8_t quarter = light_2color_quarter(light_xor.light_pwm);
+            bool announce = (quarter != light_quarter);
 
-            switch (light_xor.light_pwm)
+            light_quarter = quarter;
+            if (quarter) {
+                lv_img_set_src(img_light_bg, light_image.img_bg[cck_set]);
+            }
+            switch (quarter)
             {
             case 100:
-                xEventGroupSetBits(announcement_event_group, ANNOUNCE_PWM_100_BIT);
+                if (announce) {
+                    prompt_queue_post(SOUND_TYPE_LIGHT_100, PROMPT_PRIO_NORMAL, PROMPT_KEY_LIGHT_LEVEL);
+                }
                 lv_obj_clear_flag(img_light_pwm_100, LV_OBJ_FLAG_HIDDEN);
                 lv_img_set_src(img_light_pwm_100, light_image.img_pwm_100[cck_set]);
                 break;
             case 75:
-                xEventGroupSetBits(announcement_event_group, ANNOUNCE_PWM_75_BIT);
+                if (announce) {
+                    prompt_queue_post(SOUND_TYPE_LIGHT_75, PROMPT_PRIO_NORMAL, PROMPT_KEY_LIGHT_LEVEL);
+                }
                 lv_obj_clear_flag(img_light_pwm_75, LV_OBJ_FLAG_HIDDEN);
                 lv_img_set_src(img_light_pwm_75, light_image.img_pwm_75[cck_set]);
                 break;
             case 50:
-                xEventGroupSetBits(announcement_event_group, ANNOUNCE_PWM_50_BIT);
+                if (announce) {
+                    prompt_queue_post(SOUND_TYPE_LIGHT_50, PROMPT_PRIO_NORMAL, PROMPT_KEY_LIGHT_LEVEL);
+                }
                 lv_obj_clear_flag(img_light_pwm_50, LV_OBJ_FLAG_HIDDEN);
                 lv_img_set_src(img_light_pwm_50, light_image.img_pwm_50[cck_set]);
                 break;
             case 25:
-                xEventGroupSetBits(announcement_event_group, ANNOUNCE_PWM_25_BIT);
+                if (announce) {
+                    prompt_queue_post(SOUND_TYPE_LIGHT_25, PROMPT_PRIO_NORMAL, PROMPT_KEY_LIGHT_LEVEL);
+                }
                 lv_obj_clear_flag(img_light_pwm_25, LV_OBJ_FLAG_HIDDEN);
                 lv_img_set_src(img_light_pwm_25, light_image.img_pwm_25[cck_set]);
-                lv_img_set_src(img_light_bg, light_image.img_bg[cck_set]);
                 break;
             case 0:
-                xEventGroupSetBits(announcement_event_group, ANNOUNCE_LIGHT_OFF_BIT);
+                if (announce) {
+                    prompt_queue_post(SOUND_TYPE_LIGHT_OFF, PROMPT_PRIO_NORMAL, PROMPT_KEY_LIGHT_LEVEL);
+                }
                 lv_obj_clear_flag(img_light_pwm_0, LV_OBJ_FLAG_HIDDEN);
                 lv_img_set_src(img_light_bg, &light_close_bg);
                 break;
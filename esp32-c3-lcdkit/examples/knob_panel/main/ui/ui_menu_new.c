@@ -12,8 +12,10 @@
 #endif
 
 #include "settings.h"
+#include "app_state.h"
 #include "lv_example_pub.h"
 #include "lv_example_image.h"
+#include "lv_encoder_input.h"
 
 #include "app_audio.h"
 
@@ -57,7 +59,7 @@ static lv_obj_t *tips_btn, *tips_label;
 static uint8_t tips_delay;
 static uint8_t factory_Enter;
 
-static time_out_count time_100ms, time_500ms;
+static time_out_count time_500ms;
 
 static uint32_t ui_get_num_offset(uint32_t num, int32_t max, int32_t offset)
 {
@@ -106,6 +108,41 @@ static void obj_set_to_hightlight(lv_obj_t *obj, bool enable)
     }
 }
 
+static bool menu_step(int8_t offset)
+{
+    int8_t last_index = app_index;
+    app_index = get_app_index(offset);
+
+    if ((factory_Enter < 6) && (app_index == 2)) {
+        factory_Enter = 7;
+        ESP_LOGI(TAG, "Invalid Enter factory");
+    }
+
+    if ((factory_Enter < 6) && (++factory_Enter == 6) && (app_index == 0)) {
+        ESP_LOGI(TAG, "Enter factory");
+        lv_indev_wait_release(lv_indev_get_next(NULL));
+        ui_remove_all_objs_from_encoder_group();
+        lv_func_goto_layer(&factory_Layer);
+        return true;
+    }
+
+    for (int i = 0; i < APP_NUM; i++) {
+        obj_set_to_hightlight(icons[i], i == app_index);
+    }
+    lv_obj_swap(icons[last_index], icons[get_app_index(0)]);
+    lv_img_set_src(icons[last_index], menu[last_index].icon_ns);
+    lv_img_set_src(icons[get_app_index(0)], menu[get_app_index(0)].icon);
+    lv_obj_set_style_border_color(page, menu[get_app_index(0)].theme_color, 0);
+
+    sys_param_t *param = settings_get_parameter();
+    if (LANGUAGE_CN == param->language) {
+        lv_label_set_text(label_name, menu[get_app_index(0)].name_CN);
+    } else {
+        lv_label_set_text(label_name, menu[get_app_index(0)].name_EN);
+    }
+    return false;
+}
+
 static void menu_event_cb(lv_event_t *e)
 {
     static uint8_t forbidden_sec_trigger = false;
@@ -115,44 +152,15 @@ static void menu_event_cb(lv_event_t *e)
     if (LV_EVENT_FOCUSED == code) {
         lv_group_set_editing(lv_group_get_default(), true);
     } else if (LV_EVENT_KEY == code) {
-        uint32_t key = lv_event_get_key(e);
-        if (is_time_out(&time_100ms)) {
-            int8_t last_index = app_index;
-            if (LV_KEY_RIGHT == key) {
-                app_index = get_app_index(-1);
-            } else if (LV_KEY_LEFT == key) {
-                app_index = get_app_index(1);
-            }
-            if ((factory_Enter < 6) && (app_index == 2)) {
-                factory_Enter = 7;
-                ESP_LOGI(TAG, "Invalid Enter factory");
-            }
+        int32_t steps = lv_encoder_input_get_steps(e);
 
-            if ((factory_Enter < 6) && (++factory_Enter == 6) && (app_index == 0)) {
-                ESP_LOGI(TAG, "Enter factory");
-                lv_indev_wait_release(lv_indev_get_next(NULL));
-                ui_remove_all_objs_from_encoder_group();
-                lv_func_goto_layer(&factory_Layer);
+        /* One app per detent, a fast spin moves over several */
+        for (int32_t i = 0; i < LV_ABS(steps); i++) {
+            if (menu_step((steps > 0) ? -1 : 1)) {
                 return;
             }
-
-            // audio_handle_info(SOUND_TYPE_KNOB);
-
-            for (int i = 0; i < APP_NUM; i++) {
-                obj_set_to_hightlight(icons[i], i == app_index);
-            }
-            lv_obj_swap(icons[last_index], icons[get_app_index(0)]);
-            lv_img_set_src(icons[last_index], menu[last_index].icon_ns);
-            lv_img_set_src(icons[get_app_index(0)], menu[get_app_index(0)].icon);
-            lv_obj_set_style_border_color(page, menu[get_app_index(0)].theme_color, 0);
-
-            sys_param_t *param = settings_get_parameter();
-            if (LANGUAGE_CN == param->language) {
-                lv_label_set_text(label_name, menu[get_app_index(0)].name_CN);
-            } else {
-                lv_label_set_text(label_name, menu[get_app_index(0)].name_EN);
-            }
         }
+        audio_handle_info(SOUND_TYPE_KNOB);
         feed_clock_time();
 
     } else if (LV_EVENT_CLICKED == code) {
@@ -171,8 +179,9 @@ static void menu_event_cb(lv_event_t *e)
         sys_param_t *param = settings_get_parameter();
         if (false == param->need_hint) {
             param->need_hint = true;
-            settings_write_parameter_to_nvs();
+            settings_save();
         }
+        app_state_reset();
         set_tips_info();
     }
 }
@@ -267,7 +276,6 @@ static bool main_layer_enter_cb(void *layer)
 
         ui_menu_init(create_layer->lv_obj_layer);
     }
-    set_time_out(&time_100ms, 200);
     set_time_out(&time_500ms, 500);
     feed_clock_time();
 
@@ -288,6 +296,8 @@ static void main_layer_timer_cb(lv_timer_t *tmr)
             tips_delay--;
             if (0 == tips_delay) {
                 lv_obj_add_flag(tips_btn, LV_OBJ_FLAG_HIDDEN);
+                settings_flush();
+                app_state_flush();
                 esp_restart();
             }
         }
@@ -10,11 +10,13 @@
 
 #include "lv_example_pub.h"
 #include "lv_example_image.h"
+#include "lv_encoder_input.h"
+#include "lv_static_backing.h"
+#include "app_state.h"
 
 static lv_obj_t *temp_arc;
 static lv_obj_t *page;
 static lv_obj_t *temp_wheel;
-static time_out_count time_500ms;
 
 static bool thermostat_layer_enter_cb(void *layer);
 static bool thermostat_layer_exit_cb(void *layer);
@@ -39,22 +41,12 @@ static void thermostat_event_cb(lv_event_t *e)
     if (LV_EVENT_FOCUSED == code) {
         lv_group_set_editing(lv_group_get_default(), true);
     } else if (LV_EVENT_KEY == code) {
-
-        if (is_time_out(&time_500ms)) {
-            uint32_t key = lv_event_get_key(e);
-            current = lv_arc_get_value(temp_arc);
-            if (LV_KEY_RIGHT == key) {
-                if (current < lv_arc_get_max_value(temp_arc)) {
-                    current++;
-                }
-            } else {
-                if (current > lv_arc_get_min_value(temp_arc)) {
-                    current--;
-                }
-            }
-            lv_arc_set_value(temp_arc, current);
-            lv_roller_set_selected(temp_wheel, (current - 19), LV_ANIM_ON);
-        }
+        current = LV_CLAMP(lv_arc_get_min_value(temp_arc),
+                           lv_arc_get_value(temp_arc) + lv_encoder_input_get_accel_steps(e),
+                           lv_arc_get_max_value(temp_arc));
+        lv_arc_set_value(temp_arc, current);
+        app_state_set(APP_STATE_THERMOSTAT_TEMP, current);
+        lv_roller_set_selected(temp_wheel, (current - 19), LV_ANIM_ON);
 
     } else if (LV_EVENT_LONG_PRESSED == code) {
         lv_indev_wait_release(lv_indev_get_next(NULL));
@@ -63,6 +55,11 @@ static void thermostat_event_cb(lv_event_t *e)
     }
 }
 
+static void thermostat_bg_ready_cb(lv_anim_t *a)
+{
+    lv_static_backing_create(page);
+}
+
 static void mask_event_cb(lv_event_t *e)
 {
     lv_event_code_t code = lv_event_get_code(e);
@@ -172,17 +169,19 @@ void ui_thermostat_init(lv_obj_t *parent)
     lv_obj_t *img_thermostat_bg = lv_img_create(page);
     lv_img_set_src(img_thermostat_bg, &AC_BG);
     lv_obj_align(img_thermostat_bg, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_add_flag(img_thermostat_bg, LV_STATIC_BACKING_FLAG);
 
     lv_obj_t *img_thermostat_temp = lv_img_create(page);
     lv_img_set_src(img_thermostat_temp, &AC_temper);
     lv_obj_align(img_thermostat_temp, LV_ALIGN_CENTER, 0, 20);
+    lv_obj_add_flag(img_thermostat_temp, LV_STATIC_BACKING_FLAG);
 
     temp_arc = lv_arc_create(page);
     lv_obj_set_size(temp_arc, LV_HOR_RES - 40, LV_VER_RES - 40);
     lv_arc_set_rotation(temp_arc, 180 + (180 - 150) / 2);
     lv_arc_set_bg_angles(temp_arc, 0, 150);
-    lv_arc_set_value(temp_arc, 22);
     lv_arc_set_range(temp_arc, 19, 30);
+    lv_arc_set_value(temp_arc, app_state_get(APP_STATE_THERMOSTAT_TEMP));
     lv_obj_set_style_arc_width(temp_arc, 10, LV_PART_MAIN);
     lv_obj_set_style_arc_width(temp_arc, 10, LV_PART_INDICATOR);
 
@@ -209,9 +208,10 @@ void ui_thermostat_init(lv_obj_t *parent)
     lv_obj_t *img_temp_unit = lv_img_create(page);
     lv_img_set_src(img_temp_unit, &AC_unit);
     lv_obj_align(img_temp_unit, LV_ALIGN_CENTER, 50, -10);
+    lv_obj_add_flag(img_temp_unit, LV_STATIC_BACKING_FLAG);
 
     lv_create_obj_roller(parent);
-    lv_roller_set_selected(temp_wheel, (22 - 19), LV_ANIM_ON);
+    lv_roller_set_selected(temp_wheel, (lv_arc_get_value(temp_arc) - 19), LV_ANIM_ON);
 
     lv_anim_t a1;
     lv_anim_init(&a1);
@@ -231,6 +231,8 @@ void ui_thermostat_init(lv_obj_t *parent)
     lv_anim_set_path_cb(&a2, lv_anim_path_overshoot);
     //lv_anim_set_time(&a2, 400);
     lv_anim_set_time(&a1, 400 * 3);
+    /* bake the background once the temperature image stopped moving */
+    lv_anim_set_ready_cb(&a2, thermostat_bg_ready_cb);
     lv_anim_start(&a2);
 
     ui_remove_all_objs_from_encoder_group();//roll will add event default.
@@ -253,7 +255,6 @@ static bool thermostat_layer_enter_cb(void *layer)
         lv_obj_set_size(create_layer->lv_obj_layer, LV_HOR_RES, LV_VER_RES);
 
         ui_thermostat_init(create_layer->lv_obj_layer);
-        set_time_out(&time_500ms, 100);
     }
     return ret;
 }
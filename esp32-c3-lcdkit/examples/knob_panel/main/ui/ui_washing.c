@@ -11,13 +11,17 @@
 #include "src/misc/lv_math.h"
 
 #include "settings.h"
-#include "app_audio.h"
+#include "app_prompt_queue.h"
+#include "app_state.h"
 #include "lv_example_pub.h"
 #include "lv_example_image.h"
+#include "lv_encoder_input.h"
+#include "lv_static_backing.h"
 
 static bool washing_layer_enter_cb(void *layer);
 static bool washing_layer_exit_cb(void *layer);
 static void washing_layer_timer_cb(lv_timer_t *tmr);
+static void func_anim_ready_cb(lv_anim_t *a);
 
 lv_layer_t washing_Layer = {
     .lv_obj_name    = "washing_Layer",
@@ -67,6 +71,7 @@ static lv_obj_t *label_leftTimeH, *label_leftTimeL, *label_leftTime_unit;
 
 static WASH_MODE_T wash_mode, wash_mode_xor;
 static uint8_t item_central;
+static int32_t item_pending;
 static uint32_t wash_time_left, wash_demo_left;
 static time_out_count time_1000ms;
 
@@ -174,13 +179,49 @@ static void func_anim_cb(void *args, int32_t v)
     }
 }
 
+static void func_slide_start(void)
+{
+    if (0 == item_pending) {
+        return;
+    }
+
+    int changed = (item_pending > 0) ? 1 : -1;
+    /* A fast spin jumps over the programs in between and slides only the last one in */
+    if (LV_ABS(item_pending) > 1) {
+        item_central = get_next_cycle_position((item_pending - changed) % FUNC_NUM);
+        menu_position_reset();
+    }
+    item_pending = 0;
+
+    for (size_t i = 0; i < FUNC_NUM; i++) {
+        cycle_init_y_axis[i] = lv_obj_get_y_aligned(img_funcs[i]);
+        cycle_init_x_axis[i] = lv_obj_get_x_aligned(img_funcs[i]);
+    }
+
+    lv_anim_t a1;
+    lv_anim_init(&a1);
+    lv_anim_set_var(&a1, (void *)changed);
+    lv_anim_set_delay(&a1, 0);
+    //lv_anim_set_values(&a1, 0, 45);
+    lv_anim_set_values(&a1, 0, 80 - LV_ABS(cycle_init_y_axis[item_central]));
+    lv_anim_set_exec_cb(&a1, func_anim_cb);
+    lv_anim_set_path_cb(&a1, lv_anim_path_ease_in_out);
+    lv_anim_set_ready_cb(&a1, func_anim_ready_cb);
+    lv_anim_set_user_data(&a1, (void *)changed);
+    lv_anim_set_time(&a1, 350);
+    lv_anim_start(&a1);
+}
+
 static void func_anim_ready_cb(lv_anim_t *a)
 {
     int extra_icon_index = (int)lv_anim_get_user_data(a);
     int8_t dir = extra_icon_index > 0 ? 1 : -1;
 
     item_central = get_next_cycle_position(dir);
+    app_state_set(APP_STATE_WASH_PROGRAM, item_central);
     menu_position_reset();
+    /* Detents turned during the slide */
+    func_slide_start();
 }
 
 static void washing_event_cb(lv_event_t *e)
@@ -192,35 +233,11 @@ static void washing_event_cb(lv_event_t *e)
     if (LV_EVENT_FOCUSED == code) {
         lv_group_set_editing(lv_group_get_default(), true);
     } else if (LV_EVENT_KEY == code) {
-        uint32_t key = lv_event_get_key(e);
-        int changed = 0;
-        if (LV_KEY_LEFT == key) {
-            changed = 1;
-        } else if (LV_KEY_RIGHT == key) {
-            changed = -1;
-        }
-        if (lv_obj_get_y_aligned(img_funcs[item_central]) != 0) {
-            changed = 0;
-        } else {
-            for (size_t i = 0; i < FUNC_NUM; i++) {
-                cycle_init_y_axis[i] = lv_obj_get_y_aligned(img_funcs[i]);
-                cycle_init_x_axis[i] = lv_obj_get_x_aligned(img_funcs[i]);
-            }
-        }
-
-        if (changed) {
-            lv_anim_t a1;
-            lv_anim_init(&a1);
-            lv_anim_set_var(&a1, (void *)changed);
-            lv_anim_set_delay(&a1, 0);
-            //lv_anim_set_values(&a1, 0, 45);
-            lv_anim_set_values(&a1, 0, 80 - LV_ABS(cycle_init_y_axis[item_central]));
-            lv_anim_set_exec_cb(&a1, func_anim_cb);
-            lv_anim_set_path_cb(&a1, lv_anim_path_ease_in_out);
-            lv_anim_set_ready_cb(&a1, func_anim_ready_cb);
-            lv_anim_set_user_data(&a1, (void *)changed);
-            lv_anim_set_time(&a1, 350);
-            lv_anim_start(&a1);
+        /* All detents of the read, LV_KEY_LEFT moves the list down */
+        item_pending -= lv_encoder_input_get_steps(e);
+        /* While sliding the detents wait for the slide to end */
+        if (0 == lv_obj_get_y_aligned(img_funcs[item_central])) {
+            func_slide_start();
         }
 
     } else if (LV_EVENT_LONG_PRESSED == code) {
@@ -315,6 +332,9 @@ void ui_washing_init(lv_obj_t *parent)
 {
     sys_param_t *param = settings_get_parameter();
 
+    item_central = app_state_get(APP_STATE_WASH_PROGRAM);
+    item_pending = 0;
+
     page_background = lv_obj_create(parent);
     lv_obj_set_size(page_background, LV_HOR_RES, LV_VER_RES);
 
@@ -511,10 +531,12 @@ void ui_washing_init(lv_obj_t *parent)
     lv_obj_add_event_cb(page_background, washing_event_cb, LV_EVENT_CLICKED, NULL);
     ui_add_obj_to_encoder_group(page_background);
 
-    item_central = 0;
     wash_mode = WASH_MODE_STANDBY;
     wash_mode_xor = WASH_MODE_MAX;
     menu_position_reset();
+
+    /* only the circular border is cached, standby and run pages stay dynamic */
+    lv_static_backing_create(page_background);
 }
 
 static bool washing_layer_enter_cb(void *layer)
@@ -573,7 +595,8 @@ static void washing_layer_timer_cb(lv_timer_t *tmr)
             lv_obj_add_flag(label_leftTime_unit, LV_OBJ_FLAG_HIDDEN);
             lv_label_set_text(label_leftTimeH, "-");
             lv_label_set_text(label_leftTimeL, "-");
-            audio_handle_info((LANGUAGE_CN == param->language) ? SOUND_TYPE_WASH_END_CN : SOUND_TYPE_WASH_END_EN);
+            prompt_queue_post((LANGUAGE_CN == param->language) ? SOUND_TYPE_WASH_END_CN : SOUND_TYPE_WASH_END_EN,
+                              PROMPT_PRIO_NORMAL, PROMPT_KEY_NONE);
         }
         break;
         default:
@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: CC0-1.0
+#
+# Report the flash that identical images and identical tiles cost in the LVGL image sources of
+# main/ui/imgs. Only the pixel data built with the project config (16 bit, swapped) is looked at.
+#
+# For every image the pixel data is cut into TILE x TILE tiles; a tile is counted as a
+# duplicate when the same bytes were already seen in any image. The reclaimable size of a
+# tiled format is the duplicated tile data minus a 2 byte tile index per tile.
+
+import argparse
+import hashlib
+import os
+import re
+import sys
+
+BRANCH = 'LV_COLOR_DEPTH == 16 && LV_COLOR_16_SWAP != 0'
+TILE_INDEX_SIZE = 2
+
+PIXEL_SIZE = {
+    'LV_IMG_CF_TRUE_COLOR': 2,
+    'LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED': 2,
+    'LV_IMG_CF_TRUE_COLOR_ALPHA': 3,
+}
+
+MAP_RE = re.compile(r'uint8_t\s+(\w+)_map\[\]\s*=\s*\{(.*?)\n\};', re.S)
+DSC_RE = re.compile(r'lv_img_dsc_t\s+(\w+)\s*=\s*\{(.*?)\};', re.S)
+FIELD_RE = r'\.header\.%s\s*=\s*(\w+)'
+
+
+def branch_bytes(body):
+    # Keep the 16 bit swapped branch, or everything if the format has no per depth branches
+    if '#if' not in body:
+        return bytes(int(x, 16) for x in re.findall(r'0x([0-9a-fA-F]{2})', body))
+    data = b''
+    for block in re.findall(r'#if (.*?)\n(.*?)#endif', body, re.S):
+        if block[0].strip() == BRANCH:
+            data += bytes(int(x, 16) for x in re.findall(r'0x([0-9a-fA-F]{2})', block[1]))
+    return data
+
+
+def load_images(root):
+    images = []
+    for dirpath, _, files in os.walk(root):
+        for file in sorted(files):
+            if not file.endswith('.c'):
+                continue
+            with open(os.path.join(dirpath, file)) as f:
+                src = f.read()
+            maps = {m.group(1): m.group(2) for m in MAP_RE.finditer(src)}
+            for dsc in DSC_RE.finditer(src):
+                name, fields = dsc.group(1), dsc.group(2)
+                cf = re.search(FIELD_RE % 'cf', fields)
+                w = re.search(FIELD_RE % 'w', fields)
+                h = re.search(FIELD_RE % 'h', fields)
+                if not (cf and w and h and name in maps):
+                    continue
+                images.append((name, cf.group(1), int(w.group(1)), int(h.group(1)), branch_bytes(maps[name])))
+    return images
+
+
+def tiles(data, w, h, px, tile):
+    for ty in range(0, h, tile):
+        for tx in range(0, w, tile):
+            rows = []
+            for y in range(ty, min(ty + tile, h)):
+                start = (y * w + tx) * px
+                rows.append(data[start:start + min(tile, w - tx) * px])
+            yield b''.join(rows)
+
+
+def report(root, tile):
+    images = load_images(root)
+    whole = {}
+    seen = {}
+    total = whole_dup = tile_dup = tile_count = 0
+
+    print('%-28s %-36s %9s %12s %10s' % ('image', 'format', 'bytes', 'dup tiles', 'dup bytes'))
+    for name, cf, w, h, data in images:
+        total += len(data)
+        digest = hashlib.sha256(data).digest()
+        if digest in whole:
+            whole_dup += len(data)
+            print('%-28s %-36s %9d %12s %10d' % (name, cf, len(data), '= ' + whole[digest], len(data)))
+            continue
+        whole[digest] = name
+
+        px = PIXEL_SIZE.get(cf)
+        if px is None or len(data) < w * h * px:
+            print('%-28s %-36s %9d %12s' % (name, cf, len(data), 'not tiled'))
+            continue
+        dup = dup_bytes = num = 0
+        for t in tiles(data, w, h, px, tile):
+            num += 1
+            key = hashlib.sha256(t).digest()
+            if key in seen:
+                dup += 1
+                dup_bytes += len(t)
+            else:
+                seen[key] = name
+        tile_count += num
+        tile_dup += dup_bytes
+        print('%-28s %-36s %9d %7d / %-4d %10d' % (name, cf, len(data), dup, num, dup_bytes))
+
+    index = tile_count * TILE_INDEX_SIZE
+    print()
+    print('%d images, %d bytes of pixel data in the app partition' % (len(images), total))
+    print('identical images: %d bytes reclaimable' % whole_dup)
+    print('identical %dx%d tiles: %d bytes, %d bytes reclaimable after a %d byte tile index'
+          % (tile, tile, tile_dup, max(0, tile_dup - index), index))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Report duplicate images and tiles of the LVGL image sources')
+    parser.add_argument('root', nargs='?', default=os.path.join(os.path.dirname(__file__), '..', 'main', 'ui', 'imgs'))
+    parser.add_argument('--tile', type=int, default=16, help='tile edge in pixels')
+    args = parser.parse_args()
+
+    if args.tile <= 0:
+        sys.exit('error: bad tile size')
+    report(args.root, args.tile)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,292 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: CC0-1.0
+#
+# Pack the voice prompts into the raw image flashed to the `prompts` partition.
+# The layout must match main/app_prompt_archive.h:
+#
+#   header   magic "PRMT", u16 version, u16 entry count, u32 hash seed, u16 hash slots, u16 payload alignment,
+#            u32 CRC32 of the entries and the hash table
+#   entries  char name[24], u32 offset, u32 size, u32 sample rate, u32 CRC32 of the payload, u8 format,
+#            u8 reserved[3]
+#   hash     u16 entry index per slot, 0xffff if empty, slot = fnv1a(seed, name) & (slots - 1)
+#   payload  ALIGN byte aligned, offsets are relative to the start of the image
+#
+# Identical payloads are stored once, the entries of the copies point to the same offset.
+#
+# The seed is searched at build time so that no two names share a slot (a perfect hash), the
+# firmware then finds a prompt with one hash and one name compare.
+#
+# .mp3 files are stored as they are, .wav files (16 bit mono PCM) are stored as raw PCM
+# so that the player can feed them to I2S straight from the mapped partition.
+#
+# With --normalize every prompt is run through ffmpeg instead: leading and trailing silence is
+# trimmed, the loudness is normalized and the result is stored as 16 bit mono PCM at --rate, so
+# all prompts play at the same level and in the same format. The output is checked for its
+# format, duration and peak level before it is packed.
+#
+# PCM prompts longer than --adpcm-min-ms are encoded to 4 bit IMA-ADPCM (main/app_adpcm.h): blocks
+# of ADPCM_BLOCK_SIZE bytes made of an int16 first sample, a u8 step index, a u8 flags byte and
+# the codes, low nibble first. The last block may be as short as its header; when its sample count
+# is even, the high nibble of its last byte is padding and ADPCM_BLOCK_PADDED is set in its flags,
+# so the decoder outputs exactly the samples encoded. Short prompts such as the knob click stay PCM.
+
+import argparse
+import hashlib
+import os
+import struct
+import subprocess
+import sys
+import wave
+import zlib
+
+MAGIC = b'PRMT'
+VERSION = 2
+NAME_LEN = 24
+HEADER = struct.Struct('<4sHHIHHI')
+ENTRY = struct.Struct('<%dsIIIIB3x' % NAME_LEN)
+SLOT = struct.Struct('<H')
+SLOT_EMPTY = 0xffff
+ALIGN = 32
+SEED_MAX = 0x10000
+
+NORMALIZE_RATE = 16000
+NORMALIZE_LUFS = -16
+NORMALIZE_PEAK_DB = -1.5
+TRIM_THRESHOLD_DB = -50
+DURATION_MAX_S = 10
+
+FORMAT_MP3 = 0
+FORMAT_PCM16 = 1
+FORMAT_ADPCM = 2
+FORMAT_NAMES = {FORMAT_MP3: 'mp3', FORMAT_PCM16: 'pcm16', FORMAT_ADPCM: 'adpcm'}
+
+ADPCM_BLOCK_SIZE = 256
+ADPCM_BLOCK_SAMPLES = 1 + 2 * (ADPCM_BLOCK_SIZE - 4)
+ADPCM_BLOCK_PADDED = 0x01
+ADPCM_MIN_MS = 500
+
+ADPCM_STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]
+ADPCM_INDEX = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def load_prompt(path):
+    ext = os.path.splitext(path)[1].lower()
+    if ext == '.mp3':
+        with open(path, 'rb') as f:
+            return FORMAT_MP3, 0, f.read()
+    if ext == '.wav':
+        with wave.open(path, 'rb') as w:
+            if w.getsampwidth() != 2 or w.getnchannels() != 1:
+                raise ValueError('%s: only 16 bit mono wav is supported' % path)
+            return FORMAT_PCM16, w.getframerate(), w.readframes(w.getnframes())
+    return None
+
+
+def fnv1a(seed, name):
+    h = 2166136261 ^ seed
+    for c in name:
+        h = ((h ^ c) * 16777619) & 0xffffffff
+    return h
+
+
+def perfect_hash(names):
+    slots = 1
+    while slots < 2 * len(names):
+        slots *= 2
+    while True:
+        for seed in range(SEED_MAX):
+            table = [SLOT_EMPTY] * slots
+            for i, name in enumerate(names):
+                slot = fnv1a(seed, name) & (slots - 1)
+                if table[slot] != SLOT_EMPTY:
+                    break
+                table[slot] = i
+            else:
+                return seed, table
+        slots *= 2
+
+
+def normalize_prompt(path, rate):
+    if os.path.splitext(path)[1].lower() not in ('.mp3', '.wav'):
+        return None
+    trim = 'silenceremove=start_periods=1:start_threshold=%ddB:start_silence=0.02' % TRIM_THRESHOLD_DB
+    chain = ','.join([trim, 'areverse', trim, 'areverse',
+                      'loudnorm=I=%d:TP=%.1f:LRA=11' % (NORMALIZE_LUFS, NORMALIZE_PEAK_DB),
+                      'aresample=%d' % rate])
+    cmd = ['ffmpeg', '-v', 'error', '-i', path, '-af', chain, '-ac', '1', '-f', 's16le', '-acodec', 'pcm_s16le', '-']
+    try:
+        pcm = subprocess.run(cmd, check=True, stdout=subprocess.PIPE).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        raise ValueError('%s: ffmpeg failed (%s)' % (path, e))
+    check_prompt(path, pcm, rate)
+    return FORMAT_PCM16, rate, pcm
+
+
+def check_prompt(path, pcm, rate):
+    samples = struct.unpack('<%dh' % (len(pcm) // 2), pcm[:len(pcm) // 2 * 2])
+    if len(pcm) % 2 or not samples:
+        raise ValueError('%s: no 16 bit samples after normalizing' % path)
+    duration = len(samples) / rate
+    if duration > DURATION_MAX_S:
+        raise ValueError('%s: %.2f s is longer than %d s' % (path, duration, DURATION_MAX_S))
+    # Leave 0.5 dB for the true peak estimate of loudnorm
+    peak = max(abs(x) for x in samples)
+    if peak > 32767 * 10 ** ((NORMALIZE_PEAK_DB + 0.5) / 20):
+        raise ValueError('%s: peak %d exceeds %.1f dBFS' % (path, peak, NORMALIZE_PEAK_DB))
+
+
+def adpcm_encode_sample(sample, predictor, index):
+    # Pick the code, then update the state exactly like the decoder does
+    step = ADPCM_STEPS[index]
+    delta = sample - predictor
+    code = 8 if delta < 0 else 0
+    delta = abs(delta)
+    if delta >= step:
+        code |= 4
+        delta -= step
+    if delta >= step >> 1:
+        code |= 2
+        delta -= step >> 1
+    if delta >= step >> 2:
+        code |= 1
+
+    diff = step >> 3
+    if code & 4:
+        diff += step
+    if code & 2:
+        diff += step >> 1
+    if code & 1:
+        diff += step >> 2
+    predictor = max(-32768, min(32767, predictor - diff if code & 8 else predictor + diff))
+    index = max(0, min(88, index + ADPCM_INDEX[code & 7]))
+    return code, predictor, index
+
+
+def adpcm_encode(pcm):
+    samples = struct.unpack('<%dh' % (len(pcm) // 2), pcm)
+    out = b''
+    index = 0
+    for start in range(0, len(samples), ADPCM_BLOCK_SAMPLES):
+        block = samples[start:start + ADPCM_BLOCK_SAMPLES]
+        predictor = block[0]
+        flags = 0
+        data = bytearray(struct.pack('<hBB', predictor, index, flags))
+        codes = []
+        for sample in block[1:]:
+            code, predictor, index = adpcm_encode_sample(sample, predictor, index)
+            codes.append(code)
+        if len(codes) % 2:
+            codes.append(0)
+            data[3] |= ADPCM_BLOCK_PADDED
+        data += bytes(codes[i] | (codes[i + 1] << 4) for i in range(0, len(codes), 2))
+        out += data
+    return out
+
+
+def pack(src_dir, out_path, max_size, rate=0, adpcm_min_ms=ADPCM_MIN_MS):
+    prompts = []
+    for name in sorted(os.listdir(src_dir)):
+        path = os.path.join(src_dir, name)
+        prompt = normalize_prompt(path, rate) if rate else load_prompt(path)
+        if prompt is None:
+            continue
+        if len(name) >= NAME_LEN:
+            raise ValueError('%s: name longer than %d characters' % (name, NAME_LEN - 1))
+        fmt, prompt_rate, data = prompt
+        if fmt == FORMAT_PCM16 and adpcm_min_ms and len(data) // 2 * 1000 > adpcm_min_ms * prompt_rate:
+            fmt, data = FORMAT_ADPCM, adpcm_encode(data)
+        if rate:
+            # Normalized prompts keep their source name, the player looks them up by it
+            print('  %-24s %6.2f s %s' % (name, len(prompt[2]) / 2 / rate, FORMAT_NAMES[fmt]))
+        prompts.append((name, fmt, prompt_rate, data))
+
+    seed, table = perfect_hash([p[0].encode() for p in prompts])
+    hash_table = b''.join(SLOT.pack(i) for i in table)
+
+    offset = HEADER.size + ENTRY.size * len(prompts) + len(hash_table)
+    entries = b''
+    payload = b''
+    blobs = {}
+    reclaimed = 0
+    for name, fmt, rate, data in prompts:
+        digest = hashlib.sha256(data).digest()
+        if digest in blobs:
+            data_offset = blobs[digest]
+            reclaimed += len(data)
+        else:
+            pad = -(offset + len(payload)) % ALIGN
+            payload += b'\0' * pad
+            data_offset = blobs[digest] = offset + len(payload)
+            payload += data
+        entries += ENTRY.pack(name.encode(), data_offset, len(data), rate, zlib.crc32(data), fmt)
+
+    index = entries + hash_table
+    image = HEADER.pack(MAGIC, VERSION, len(prompts), seed, len(table), ALIGN, zlib.crc32(index)) + index + payload
+    if max_size and len(image) > max_size:
+        raise ValueError('image is %d bytes, partition only has %d' % (len(image), max_size))
+    with open(out_path, 'wb') as f:
+        f.write(image)
+    print('%d prompts, %d bytes, %d hash slots with seed %d' % (len(prompts), len(image), len(table), seed))
+    print('%d unique payloads, %d bytes reclaimed by %d aliases (%d%% of the payload)'
+          % (len(blobs), reclaimed, len(prompts) - len(blobs), 100 * reclaimed // max(1, reclaimed + len(payload))))
+    if max_size:
+        print('prompts partition: %d of %d bytes used' % (len(image), max_size))
+
+
+def dump(path):
+    with open(path, 'rb') as f:
+        image = f.read()
+    magic, version, count, seed, slots, align, index_crc = HEADER.unpack_from(image, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('%s: not a version %d image' % (path, VERSION))
+    index_len = ENTRY.size * count + SLOT.size * slots
+    if zlib.crc32(image[HEADER.size:HEADER.size + index_len]) != index_crc:
+        raise ValueError('%s: index CRC mismatch' % path)
+    print('version %d, %d prompts, %d bytes, %d hash slots with seed %d' % (version, count, len(image), slots, seed))
+    owners = {}
+    for i in range(count):
+        name, offset, size, rate, crc, fmt = ENTRY.unpack_from(image, HEADER.size + i * ENTRY.size)
+        name = name.rstrip(b'\0').decode()
+        if offset + size > len(image) or offset % align:
+            raise ValueError('%s: entry %d out of bounds' % (path, i))
+        if zlib.crc32(image[offset:offset + size]) != crc:
+            raise ValueError('%s: entry %d CRC mismatch' % (path, i))
+        alias = (' = %s' % owners[offset]) if offset in owners else ''
+        owners.setdefault(offset, name)
+        print('  %-24s %-6s %6d Hz %7d bytes @ 0x%06x crc %08x%s' % (name, FORMAT_NAMES.get(fmt, '?'), rate, size,
+                                                                       offset, crc, alias))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Pack voice prompts into a raw partition image')
+    parser.add_argument('src', help='directory with the .mp3 / .wav prompts, or the image with --dump')
+    parser.add_argument('out', nargs='?', help='output image')
+    parser.add_argument('--max-size', type=lambda x: int(x, 0), default=0, help='partition size')
+    parser.add_argument('--dump', action='store_true', help='list the entries of an image')
+    parser.add_argument('--normalize', action='store_true',
+                        help='trim, loudness normalize and resample every prompt to PCM with ffmpeg')
+    parser.add_argument('--rate', type=int, default=NORMALIZE_RATE, help='sample rate of normalized prompts')
+    parser.add_argument('--adpcm-min-ms', type=int, default=ADPCM_MIN_MS,
+                        help='encode PCM prompts longer than this to IMA-ADPCM, 0 keeps all PCM')
+    args = parser.parse_args()
+
+    try:
+        if args.dump:
+            dump(args.src)
+        else:
+            pack(args.src, args.out, args.max_size, args.rate if args.normalize else 0, args.adpcm_min_ms)
+    except ValueError as e:
+        sys.exit('error: %s' % e)
+
+
+if __name__ == '__main__':
+    main()